@@ -95,6 +95,38 @@
       : "r"(arg0), "r"(arg1), "r"(arg2), "r"(arg3), "I"(value)          \
       : "a0", "a1", "a2", "a3");
 
+/// __srai_registers
+///
+/// Invoke the magic instruction defined by SIMICS for the RISC-V architecture
+/// with a specific value of `n` and pseudo-arguments in registers `a0` and
+/// `a1`, then read the values of registers `a4`, `a5`, `a6`, and `a7` after
+/// the instruction completes. The fuzzer writes each testcase to these
+/// registers.
+///
+/// # Arguments
+///
+/// * `value` - The value of `n` to use in the magic instruction
+/// * `arg0` - The value to place in register `a0`
+/// * `arg1` - The value to place in register `a1`
+/// * `reg0` - The variable to store the value of register `a4` in
+/// * `reg1` - The variable to store the value of register `a5` in
+/// * `reg2` - The variable to store the value of register `a6` in
+/// * `reg3` - The variable to store the value of register `a7` in
+#define __srai_registers(value, arg0, arg1, reg0, reg1, reg2, reg3) \
+  register unsigned long _a0 __asm__("a0") = (arg0);                \
+  register unsigned long _a1 __asm__("a1") = (arg1);                \
+  register unsigned long _a4 __asm__("a4") = (reg0);                \
+  register unsigned long _a5 __asm__("a5") = (reg1);                \
+  register unsigned long _a6 __asm__("a6") = (reg2);                \
+  register unsigned long _a7 __asm__("a7") = (reg3);                \
+  __asm__ __volatile__("srai zero, zero, %6"                        \
+                       : "+r"(_a4), "+r"(_a5), "+r"(_a6), "+r"(_a7) \
+                       : "r"(_a0), "r"(_a1), "I"(value));           \
+  (reg0) = _a4;                                                     \
+  (reg1) = _a5;                                                     \
+  (reg2) = _a6;                                                     \
+  (reg3) = _a7;
+
 /// Magic value defined by SIMICS as the "leaf" value of a CPUID instruction
 /// that is treated as a magic instruction.
 #define MAGIC (0x4711U)
@@ -338,6 +370,296 @@
     __srai_extended4(N_START_BUFFER_PTR_SIZE_PTR_VAL, start_index, buffer, size_ptr, max_size);        \
   } while (0);
 
+/// Pseudo-hypercall number to signal the fuzzer to use the first argument to
+/// the magic instruction as the number of registers each testcase is written
+/// to, instead of writing each testcase to a memory buffer.
+#define N_START_REGISTERS (0x0006U)
+
+/// HARNESS_START_REGISTERS1
+///
+/// Signal the fuzzer to start the fuzzing loop at the point this macro is
+/// called, taking each testcase from register `a4` instead of a memory buffer.
+/// The default "index" of 0 will be used. If you need multiple start harnesses
+/// compiled into the same binary, you can use the
+/// `HARNESS_START_REGISTERS1_INDEX` macro to specify different indices.
+///
+/// When this macro is called:
+///
+/// - A snapshot will be taken and saved
+/// - The initial values of the variables will be saved as the initial testcase,
+///   and the maximum testcase size will be 1 times the register width.
+/// - Each fuzzing iteration, the testcase will be split into register-width
+///   little-endian values, which are written to the registers and stored in the
+///   variables in order. No guest memory is written.
+///
+/// # Arguments
+///
+/// - `reg0`: The variable which receives the first value of each testcase
+///
+/// # Example
+///
+/// ```
+/// unsigned long arg0 = 0;
+/// HARNESS_START_REGISTERS1(arg0);
+/// ```
+#define HARNESS_START_REGISTERS1(reg0)                                    \
+  do {                                                                    \
+    unsigned long _unused1 __attribute__((unused)) = 0,                   \
+                  _unused2 __attribute__((unused)) = 0,                   \
+                  _unused3 __attribute__((unused)) = 0;                   \
+    __srai_registers(N_START_REGISTERS, DEFAULT_INDEX, 1, reg0, _unused1, \
+                     _unused2, _unused3);                                 \
+  } while (0);
+
+/// HARNESS_START_REGISTERS1_INDEX
+///
+/// Signal the fuzzer to start the fuzzing loop at the point this macro is
+/// called, taking each testcase from register `a4` instead of a memory buffer.
+/// The index specified by `start_index` will be used.
+///
+/// When this macro is called:
+///
+/// - A snapshot will be taken and saved
+/// - The initial values of the variables will be saved as the initial testcase,
+///   and the maximum testcase size will be 1 times the register width.
+/// - Each fuzzing iteration, the testcase will be split into register-width
+///   little-endian values, which are written to the registers and stored in the
+///   variables in order. No guest memory is written.
+///
+/// # Arguments
+///
+/// - `start_index`: The index to use for this start harness
+/// - `reg0`: The variable which receives the first value of each testcase
+///
+/// # Example
+///
+/// ```
+/// unsigned long arg0 = 0;
+/// HARNESS_START_REGISTERS1_INDEX(0x0001U, arg0);
+/// ```
+#define HARNESS_START_REGISTERS1_INDEX(start_index, reg0)               \
+  do {                                                                  \
+    unsigned long _unused1 __attribute__((unused)) = 0,                 \
+                  _unused2 __attribute__((unused)) = 0,                 \
+                  _unused3 __attribute__((unused)) = 0;                 \
+    __srai_registers(N_START_REGISTERS, start_index, 1, reg0, _unused1, \
+                     _unused2, _unused3);                               \
+  } while (0);
+
+/// HARNESS_START_REGISTERS2
+///
+/// Signal the fuzzer to start the fuzzing loop at the point this macro is
+/// called, taking each testcase from registers `a4` and `a5` instead of a
+/// memory buffer. The default "index" of 0 will be used. If you need multiple
+/// start harnesses compiled into the same binary, you can use the
+/// `HARNESS_START_REGISTERS2_INDEX` macro to specify different indices.
+///
+/// When this macro is called:
+///
+/// - A snapshot will be taken and saved
+/// - The initial values of the variables will be saved as the initial testcase,
+///   and the maximum testcase size will be 2 times the register width.
+/// - Each fuzzing iteration, the testcase will be split into register-width
+///   little-endian values, which are written to the registers and stored in the
+///   variables in order. No guest memory is written.
+///
+/// # Arguments
+///
+/// - `reg0`: The variable which receives the first value of each testcase
+/// - `reg1`: The variable which receives the second value of each testcase
+///
+/// # Example
+///
+/// ```
+/// unsigned long arg0 = 0, arg1 = 0;
+/// HARNESS_START_REGISTERS2(arg0, arg1);
+/// ```
+#define HARNESS_START_REGISTERS2(reg0, reg1)                          \
+  do {                                                                \
+    unsigned long _unused2 __attribute__((unused)) = 0,               \
+                  _unused3 __attribute__((unused)) = 0;               \
+    __srai_registers(N_START_REGISTERS, DEFAULT_INDEX, 2, reg0, reg1, \
+                     _unused2, _unused3);                             \
+  } while (0);
+
+/// HARNESS_START_REGISTERS2_INDEX
+///
+/// Signal the fuzzer to start the fuzzing loop at the point this macro is
+/// called, taking each testcase from registers `a4` and `a5` instead of a
+/// memory buffer. The index specified by `start_index` will be used.
+///
+/// When this macro is called:
+///
+/// - A snapshot will be taken and saved
+/// - The initial values of the variables will be saved as the initial testcase,
+///   and the maximum testcase size will be 2 times the register width.
+/// - Each fuzzing iteration, the testcase will be split into register-width
+///   little-endian values, which are written to the registers and stored in the
+///   variables in order. No guest memory is written.
+///
+/// # Arguments
+///
+/// - `start_index`: The index to use for this start harness
+/// - `reg0`: The variable which receives the first value of each testcase
+/// - `reg1`: The variable which receives the second value of each testcase
+///
+/// # Example
+///
+/// ```
+/// unsigned long arg0 = 0, arg1 = 0;
+/// HARNESS_START_REGISTERS2_INDEX(0x0001U, arg0, arg1);
+/// ```
+#define HARNESS_START_REGISTERS2_INDEX(start_index, reg0, reg1)               \
+  do {                                                                        \
+    unsigned long _unused2 __attribute__((unused)) = 0,                       \
+                  _unused3 __attribute__((unused)) = 0;                       \
+    __srai_registers(N_START_REGISTERS, start_index, 2, reg0, reg1, _unused2, \
+                     _unused3);                                               \
+  } while (0);
+
+/// HARNESS_START_REGISTERS3
+///
+/// Signal the fuzzer to start the fuzzing loop at the point this macro is
+/// called, taking each testcase from registers `a4`, `a5` and `a6` instead of a
+/// memory buffer. The default "index" of 0 will be used. If you need multiple
+/// start harnesses compiled into the same binary, you can use the
+/// `HARNESS_START_REGISTERS3_INDEX` macro to specify different indices.
+///
+/// When this macro is called:
+///
+/// - A snapshot will be taken and saved
+/// - The initial values of the variables will be saved as the initial testcase,
+///   and the maximum testcase size will be 3 times the register width.
+/// - Each fuzzing iteration, the testcase will be split into register-width
+///   little-endian values, which are written to the registers and stored in the
+///   variables in order. No guest memory is written.
+///
+/// # Arguments
+///
+/// - `reg0`: The variable which receives the first value of each testcase
+/// - `reg1`: The variable which receives the second value of each testcase
+/// - `reg2`: The variable which receives the third value of each testcase
+///
+/// # Example
+///
+/// ```
+/// unsigned long arg0 = 0, arg1 = 0, arg2 = 0;
+/// HARNESS_START_REGISTERS3(arg0, arg1, arg2);
+/// ```
+#define HARNESS_START_REGISTERS3(reg0, reg1, reg2)                          \
+  do {                                                                      \
+    unsigned long _unused3 __attribute__((unused)) = 0;                     \
+    __srai_registers(N_START_REGISTERS, DEFAULT_INDEX, 3, reg0, reg1, reg2, \
+                     _unused3);                                             \
+  } while (0);
+
+/// HARNESS_START_REGISTERS3_INDEX
+///
+/// Signal the fuzzer to start the fuzzing loop at the point this macro is
+/// called, taking each testcase from registers `a4`, `a5` and `a6` instead of a
+/// memory buffer. The index specified by `start_index` will be used.
+///
+/// When this macro is called:
+///
+/// - A snapshot will be taken and saved
+/// - The initial values of the variables will be saved as the initial testcase,
+///   and the maximum testcase size will be 3 times the register width.
+/// - Each fuzzing iteration, the testcase will be split into register-width
+///   little-endian values, which are written to the registers and stored in the
+///   variables in order. No guest memory is written.
+///
+/// # Arguments
+///
+/// - `start_index`: The index to use for this start harness
+/// - `reg0`: The variable which receives the first value of each testcase
+/// - `reg1`: The variable which receives the second value of each testcase
+/// - `reg2`: The variable which receives the third value of each testcase
+///
+/// # Example
+///
+/// ```
+/// unsigned long arg0 = 0, arg1 = 0, arg2 = 0;
+/// HARNESS_START_REGISTERS3_INDEX(0x0001U, arg0, arg1, arg2);
+/// ```
+#define HARNESS_START_REGISTERS3_INDEX(start_index, reg0, reg1, reg2)     \
+  do {                                                                    \
+    unsigned long _unused3 __attribute__((unused)) = 0;                   \
+    __srai_registers(N_START_REGISTERS, start_index, 3, reg0, reg1, reg2, \
+                     _unused3);                                           \
+  } while (0);
+
+/// HARNESS_START_REGISTERS4
+///
+/// Signal the fuzzer to start the fuzzing loop at the point this macro is
+/// called, taking each testcase from registers `a4`, `a5`, `a6` and `a7`
+/// instead of a memory buffer. The default "index" of 0 will be used. If you
+/// need multiple start harnesses compiled into the same binary, you can use the
+/// `HARNESS_START_REGISTERS4_INDEX` macro to specify different indices.
+///
+/// When this macro is called:
+///
+/// - A snapshot will be taken and saved
+/// - The initial values of the variables will be saved as the initial testcase,
+///   and the maximum testcase size will be 4 times the register width.
+/// - Each fuzzing iteration, the testcase will be split into register-width
+///   little-endian values, which are written to the registers and stored in the
+///   variables in order. No guest memory is written.
+///
+/// # Arguments
+///
+/// - `reg0`: The variable which receives the first value of each testcase
+/// - `reg1`: The variable which receives the second value of each testcase
+/// - `reg2`: The variable which receives the third value of each testcase
+/// - `reg3`: The variable which receives the fourth value of each testcase
+///
+/// # Example
+///
+/// ```
+/// unsigned long arg0 = 0, arg1 = 0, arg2 = 0, arg3 = 0;
+/// HARNESS_START_REGISTERS4(arg0, arg1, arg2, arg3);
+/// ```
+#define HARNESS_START_REGISTERS4(reg0, reg1, reg2, reg3)                    \
+  do {                                                                      \
+    __srai_registers(N_START_REGISTERS, DEFAULT_INDEX, 4, reg0, reg1, reg2, \
+                     reg3);                                                 \
+  } while (0);
+
+/// HARNESS_START_REGISTERS4_INDEX
+///
+/// Signal the fuzzer to start the fuzzing loop at the point this macro is
+/// called, taking each testcase from registers `a4`, `a5`, `a6` and `a7`
+/// instead of a memory buffer. The index specified by `start_index` will be
+/// used.
+///
+/// When this macro is called:
+///
+/// - A snapshot will be taken and saved
+/// - The initial values of the variables will be saved as the initial testcase,
+///   and the maximum testcase size will be 4 times the register width.
+/// - Each fuzzing iteration, the testcase will be split into register-width
+///   little-endian values, which are written to the registers and stored in the
+///   variables in order. No guest memory is written.
+///
+/// # Arguments
+///
+/// - `start_index`: The index to use for this start harness
+/// - `reg0`: The variable which receives the first value of each testcase
+/// - `reg1`: The variable which receives the second value of each testcase
+/// - `reg2`: The variable which receives the third value of each testcase
+/// - `reg3`: The variable which receives the fourth value of each testcase
+///
+/// # Example
+///
+/// ```
+/// unsigned long arg0 = 0, arg1 = 0, arg2 = 0, arg3 = 0;
+/// HARNESS_START_REGISTERS4_INDEX(0x0001U, arg0, arg1, arg2, arg3);
+/// ```
+#define HARNESS_START_REGISTERS4_INDEX(start_index, reg0, reg1, reg2, reg3) \
+  do {                                                                      \
+    __srai_registers(N_START_REGISTERS, start_index, 4, reg0, reg1, reg2,   \
+                     reg3);                                                 \
+  } while (0);
+
 /// Pseudo-hypercall number to signal the fuzzer to stop the current fuzzing
 /// iteration and reset to the beginning of the fuzzing loop with a "normal"
 /// stop status, indicating no solution has occurred.
@@ -434,4 +756,38 @@
     __srai_extended1(N_STOP_ASSERT, assert_index);                 \
   } while (0);
 
+/// Pseudo-hypercall number to declare a guard region which the target must
+/// never access. Accesses to the region are reported as "solution" stop
+/// statuses.
+#define N_GUARD (0x0007U)
+
+/// HARNESS_GUARD
+///
+/// Declare a guard region, for example a redzone between two objects or after
+/// the end of a buffer. Writes to the region (and reads, if the fuzzer is
+/// configured to guard reads) stop the current fuzzing iteration with a
+/// "solution" stop status. Guard regions declared before the start harness
+/// persist for the rest of the fuzzing campaign, and guard regions declared
+/// after it are removed when the iteration ends, so regions on the stack of one
+/// iteration do not affect the next. Declaring the same region more than once
+/// has no effect. Unlike the start and stop harnesses, this harness does not
+/// stop the simulation.
+///
+/// # Arguments
+///
+/// - `addr`: The address of the start of the guard region
+/// - `len`: The size of the guard region in bytes
+///
+/// # Example
+///
+/// ```
+/// char buffer[0x100];
+/// char redzone[0x10];
+/// HARNESS_GUARD(redzone, sizeof(redzone));
+/// ```
+#define HARNESS_GUARD(addr, len)                             \
+  do {                                                       \
+    __srai_extended3(N_GUARD, DEFAULT_INDEX, addr, len);     \
+  } while (0);
+
 #endif  // TSFFS_H
\ No newline at end of file
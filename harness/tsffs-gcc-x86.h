@@ -125,6 +125,39 @@
                        : "a"(value), "D"(arg0), "S"(arg1), "d"(arg2), \
                          "c"(arg3));
 
+/// __cpuid_registers
+///
+/// Invoke the CPUID instruction with a specific value `value` in register
+/// `eax` and pseudo-arguments in registers `edi` and `esi`, then read the
+/// values of registers `esi` and `edi` after the instruction completes. The
+/// fuzzer writes each testcase to these registers. Because the registers carry
+/// the pseudo-arguments into the instruction, the initial values of `reg0` and
+/// `reg1` are not used.
+///
+/// # Arguments
+///
+/// - `value`: The value to load into the `eax` register before invoking the
+///   CPUID instruction
+/// - `arg0`: The value to load into the `edi` register before invoking the
+///   CPUID instruction
+/// - `arg1`: The value to load into the `esi` register before invoking the
+///   CPUID instruction
+/// - `reg0`: The variable to store the value of the `esi` register in
+/// - `reg1`: The variable to store the value of the `edi` register in
+#define __cpuid_registers(value, arg0, arg1, reg0, reg1)                   \
+  unsigned int _a __attribute__((unused)) = 0;                             \
+  unsigned int _b __attribute__((unused)) = 0;                             \
+  unsigned int _c __attribute__((unused)) = 0;                             \
+  unsigned int _d __attribute__((unused)) = 0;                             \
+  unsigned int _S = (arg1);                                                \
+  unsigned int _D = (arg0);                                                \
+  __asm__ __volatile__("cpuid\n\t"                                         \
+                       : "=a"(_a), "=b"(_b), "=c"(_c), "=d"(_d), "+S"(_S), \
+                         "+D"(_D)                                          \
+                       : "a"(value));                                      \
+  (reg0) = _S;                                                             \
+  (reg1) = _D;
+
 /// Magic value defined by SIMICS as the "leaf" value of a CPUID instruction
 /// that is treated as a magic instruction.
 #define MAGIC (0x4711U)
@@ -374,6 +407,149 @@
     __cpuid_extended4(value, start_index, buffer, size_ptr, max_size);       \
   } while (0);
 
+/// Pseudo-hypercall number to signal the fuzzer to use the first argument to
+/// the magic instruction as the number of registers each testcase is written
+/// to, instead of writing each testcase to a memory buffer.
+#define N_START_REGISTERS (0x0006U)
+
+/// HARNESS_START_REGISTERS1
+///
+/// Signal the fuzzer to start the fuzzing loop at the point this macro is
+/// called, taking each testcase from register `esi` instead of a memory buffer.
+/// The default "index" of 0 will be used. If you need multiple start harnesses
+/// compiled into the same binary, you can use the
+/// `HARNESS_START_REGISTERS1_INDEX` macro to specify different indices.
+///
+/// When this macro is called:
+///
+/// - A snapshot will be taken and saved
+/// - The initial testcase will be all zeros, because the registers hold the
+///   start index and register count when the harness starts, and the
+///   maximum testcase size will be 1 times the register width.
+/// - Each fuzzing iteration, the testcase will be split into register-width
+///   little-endian values, which are written to the registers and stored in the
+///   variables in order. No guest memory is written.
+///
+/// # Arguments
+///
+/// - `reg0`: The variable which receives the first value of each testcase
+///
+/// # Example
+///
+/// ```
+/// unsigned long arg0 = 0;
+/// HARNESS_START_REGISTERS1(arg0);
+/// ```
+#define HARNESS_START_REGISTERS1(reg0)                          \
+  do {                                                          \
+    unsigned int _unused1 __attribute__((unused)) = 0;          \
+    unsigned int value = (N_START_REGISTERS << 0x10U) | MAGIC;  \
+    __cpuid_registers(value, DEFAULT_INDEX, 1, reg0, _unused1); \
+  } while (0);
+
+/// HARNESS_START_REGISTERS1_INDEX
+///
+/// Signal the fuzzer to start the fuzzing loop at the point this macro is
+/// called, taking each testcase from register `esi` instead of a memory buffer.
+/// The index specified by `start_index` will be used.
+///
+/// When this macro is called:
+///
+/// - A snapshot will be taken and saved
+/// - The initial testcase will be all zeros, because the registers hold the
+///   start index and register count when the harness starts, and the
+///   maximum testcase size will be 1 times the register width.
+/// - Each fuzzing iteration, the testcase will be split into register-width
+///   little-endian values, which are written to the registers and stored in the
+///   variables in order. No guest memory is written.
+///
+/// # Arguments
+///
+/// - `start_index`: The index to use for this start harness
+/// - `reg0`: The variable which receives the first value of each testcase
+///
+/// # Example
+///
+/// ```
+/// unsigned long arg0 = 0;
+/// HARNESS_START_REGISTERS1_INDEX(0x0001U, arg0);
+/// ```
+#define HARNESS_START_REGISTERS1_INDEX(start_index, reg0)      \
+  do {                                                         \
+    unsigned int _unused1 __attribute__((unused)) = 0;         \
+    unsigned int value = (N_START_REGISTERS << 0x10U) | MAGIC; \
+    __cpuid_registers(value, start_index, 1, reg0, _unused1);  \
+  } while (0);
+
+/// HARNESS_START_REGISTERS2
+///
+/// Signal the fuzzer to start the fuzzing loop at the point this macro is
+/// called, taking each testcase from registers `esi` and `edi` instead of a
+/// memory buffer. The default "index" of 0 will be used. If you need multiple
+/// start harnesses compiled into the same binary, you can use the
+/// `HARNESS_START_REGISTERS2_INDEX` macro to specify different indices.
+///
+/// When this macro is called:
+///
+/// - A snapshot will be taken and saved
+/// - The initial testcase will be all zeros, because the registers hold the
+///   start index and register count when the harness starts, and the
+///   maximum testcase size will be 2 times the register width.
+/// - Each fuzzing iteration, the testcase will be split into register-width
+///   little-endian values, which are written to the registers and stored in the
+///   variables in order. No guest memory is written.
+///
+/// # Arguments
+///
+/// - `reg0`: The variable which receives the first value of each testcase
+/// - `reg1`: The variable which receives the second value of each testcase
+///
+/// # Example
+///
+/// ```
+/// unsigned long arg0 = 0, arg1 = 0;
+/// HARNESS_START_REGISTERS2(arg0, arg1);
+/// ```
+#define HARNESS_START_REGISTERS2(reg0, reg1)                   \
+  do {                                                         \
+    unsigned int value = (N_START_REGISTERS << 0x10U) | MAGIC; \
+    __cpuid_registers(value, DEFAULT_INDEX, 2, reg0, reg1);    \
+  } while (0);
+
+/// HARNESS_START_REGISTERS2_INDEX
+///
+/// Signal the fuzzer to start the fuzzing loop at the point this macro is
+/// called, taking each testcase from registers `esi` and `edi` instead of a
+/// memory buffer. The index specified by `start_index` will be used.
+///
+/// When this macro is called:
+///
+/// - A snapshot will be taken and saved
+/// - The initial testcase will be all zeros, because the registers hold the
+///   start index and register count when the harness starts, and the
+///   maximum testcase size will be 2 times the register width.
+/// - Each fuzzing iteration, the testcase will be split into register-width
+///   little-endian values, which are written to the registers and stored in the
+///   variables in order. No guest memory is written.
+///
+/// # Arguments
+///
+/// - `start_index`: The index to use for this start harness
+/// - `reg0`: The variable which receives the first value of each testcase
+/// - `reg1`: The variable which receives the second value of each testcase
+///
+/// # Example
+///
+/// ```
+/// unsigned long arg0 = 0, arg1 = 0;
+/// HARNESS_START_REGISTERS2_INDEX(0x0001U, arg0, arg1);
+/// ```
+#define HARNESS_START_REGISTERS2_INDEX(start_index, reg0, reg1) \
+  do {                                                          \
+    unsigned int value = (N_START_REGISTERS << 0x10U) | MAGIC;  \
+    __cpuid_registers(value, start_index, 2, reg0, reg1);       \
+  } while (0);
+
 /// Pseudo-hypercall number to signal the fuzzer to stop the current fuzzing
 /// iteration and reset to the beginning of the fuzzing loop with a "normal"
 /// stop status, indicating no solution has occurred.
@@ -474,4 +650,39 @@
     __cpuid_extended1(value, assert_index);                \
   } while (0);
 
+/// Pseudo-hypercall number to declare a guard region which the target must
+/// never access. Accesses to the region are reported as "solution" stop
+/// statuses.
+#define N_GUARD (0x0007U)
+
+/// HARNESS_GUARD
+///
+/// Declare a guard region, for example a redzone between two objects or after
+/// the end of a buffer. Writes to the region (and reads, if the fuzzer is
+/// configured to guard reads) stop the current fuzzing iteration with a
+/// "solution" stop status. Guard regions declared before the start harness
+/// persist for the rest of the fuzzing campaign, and guard regions declared
+/// after it are removed when the iteration ends, so regions on the stack of one
+/// iteration do not affect the next. Declaring the same region more than once
+/// has no effect. Unlike the start and stop harnesses, this harness does not
+/// stop the simulation.
+///
+/// # Arguments
+///
+/// - `addr`: The address of the start of the guard region
+/// - `len`: The size of the guard region in bytes
+///
+/// # Example
+///
+/// ```
+/// char buffer[0x100];
+/// char redzone[0x10];
+/// HARNESS_GUARD(redzone, sizeof(redzone));
+/// ```
+#define HARNESS_GUARD(addr, len)                             \
+  do {                                                       \
+    unsigned int value = (N_GUARD << 0x10U) | MAGIC;         \
+    __cpuid_extended3(value, DEFAULT_INDEX, addr, len);      \
+  } while (0);
+
 #endif  // TSFFS_H
\ No newline at end of file
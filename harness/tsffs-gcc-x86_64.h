@@ -125,6 +125,43 @@
                        : "a"(value), "D"(arg0), "S"(arg1), "d"(arg2), \
                          "c"(arg3));
 
+/// __cpuid_registers
+///
+/// Invoke the CPUID instruction with a specific value `value` in register
+/// `rax` and pseudo-arguments in registers `rdi` and `rsi`, then read the
+/// values of registers `r8`, `r9`, `r10`, and `r11` after the instruction
+/// completes. The fuzzer writes each testcase to these registers.
+///
+/// # Arguments
+///
+/// - `value`: The value to load into the `rax` register before invoking the
+///   CPUID instruction
+/// - `arg0`: The value to load into the `rdi` register before invoking the
+///   CPUID instruction
+/// - `arg1`: The value to load into the `rsi` register before invoking the
+///   CPUID instruction
+/// - `reg0`: The variable to store the value of the `r8` register in
+/// - `reg1`: The variable to store the value of the `r9` register in
+/// - `reg2`: The variable to store the value of the `r10` register in
+/// - `reg3`: The variable to store the value of the `r11` register in
+#define __cpuid_registers(value, arg0, arg1, reg0, reg1, reg2, reg3)        \
+  unsigned int _a __attribute__((unused)) = 0;                              \
+  unsigned int _b __attribute__((unused)) = 0;                              \
+  unsigned int _c __attribute__((unused)) = 0;                              \
+  unsigned int _d __attribute__((unused)) = 0;                              \
+  register unsigned long long _r8 __asm__("r8") = (reg0);                   \
+  register unsigned long long _r9 __asm__("r9") = (reg1);                   \
+  register unsigned long long _r10 __asm__("r10") = (reg2);                 \
+  register unsigned long long _r11 __asm__("r11") = (reg3);                 \
+  __asm__ __volatile__("cpuid\n\t"                                          \
+                       : "=a"(_a), "=b"(_b), "=c"(_c), "=d"(_d), "+r"(_r8), \
+                         "+r"(_r9), "+r"(_r10), "+r"(_r11)                  \
+                       : "a"(value), "D"(arg0), "S"(arg1));                 \
+  (reg0) = _r8;                                                             \
+  (reg1) = _r9;                                                             \
+  (reg2) = _r10;                                                            \
+  (reg3) = _r11;
+
 /// Magic value defined by SIMICS as the "leaf" value of a CPUID instruction
 /// that is treated as a magic instruction.
 #define MAGIC (0x4711U)
@@ -374,6 +411,299 @@
     __cpuid_extended4(value, start_index, buffer, size_ptr, max_size);       \
   } while (0);
 
+/// Pseudo-hypercall number to signal the fuzzer to use the first argument to
+/// the magic instruction as the number of registers each testcase is written
+/// to, instead of writing each testcase to a memory buffer.
+#define N_START_REGISTERS (0x0006U)
+
+/// HARNESS_START_REGISTERS1
+///
+/// Signal the fuzzer to start the fuzzing loop at the point this macro is
+/// called, taking each testcase from register `r8` instead of a memory buffer.
+/// The default "index" of 0 will be used. If you need multiple start harnesses
+/// compiled into the same binary, you can use the
+/// `HARNESS_START_REGISTERS1_INDEX` macro to specify different indices.
+///
+/// When this macro is called:
+///
+/// - A snapshot will be taken and saved
+/// - The initial values of the variables will be saved as the initial testcase,
+///   and the maximum testcase size will be 1 times the register width.
+/// - Each fuzzing iteration, the testcase will be split into register-width
+///   little-endian values, which are written to the registers and stored in the
+///   variables in order. No guest memory is written.
+///
+/// # Arguments
+///
+/// - `reg0`: The variable which receives the first value of each testcase
+///
+/// # Example
+///
+/// ```
+/// unsigned long arg0 = 0;
+/// HARNESS_START_REGISTERS1(arg0);
+/// ```
+#define HARNESS_START_REGISTERS1(reg0)                                   \
+  do {                                                                   \
+    unsigned long long _unused1 __attribute__((unused)) = 0,             \
+                       _unused2 __attribute__((unused)) = 0,             \
+                       _unused3 __attribute__((unused)) = 0;             \
+    unsigned int value = (N_START_REGISTERS << 0x10U) | MAGIC;           \
+    __cpuid_registers(value, DEFAULT_INDEX, 1, reg0, _unused1, _unused2, \
+                      _unused3);                                         \
+  } while (0);
+
+/// HARNESS_START_REGISTERS1_INDEX
+///
+/// Signal the fuzzer to start the fuzzing loop at the point this macro is
+/// called, taking each testcase from register `r8` instead of a memory buffer.
+/// The index specified by `start_index` will be used.
+///
+/// When this macro is called:
+///
+/// - A snapshot will be taken and saved
+/// - The initial values of the variables will be saved as the initial testcase,
+///   and the maximum testcase size will be 1 times the register width.
+/// - Each fuzzing iteration, the testcase will be split into register-width
+///   little-endian values, which are written to the registers and stored in the
+///   variables in order. No guest memory is written.
+///
+/// # Arguments
+///
+/// - `start_index`: The index to use for this start harness
+/// - `reg0`: The variable which receives the first value of each testcase
+///
+/// # Example
+///
+/// ```
+/// unsigned long arg0 = 0;
+/// HARNESS_START_REGISTERS1_INDEX(0x0001U, arg0);
+/// ```
+#define HARNESS_START_REGISTERS1_INDEX(start_index, reg0)              \
+  do {                                                                 \
+    unsigned long long _unused1 __attribute__((unused)) = 0,           \
+                       _unused2 __attribute__((unused)) = 0,           \
+                       _unused3 __attribute__((unused)) = 0;           \
+    unsigned int value = (N_START_REGISTERS << 0x10U) | MAGIC;         \
+    __cpuid_registers(value, start_index, 1, reg0, _unused1, _unused2, \
+                      _unused3);                                       \
+  } while (0);
+
+/// HARNESS_START_REGISTERS2
+///
+/// Signal the fuzzer to start the fuzzing loop at the point this macro is
+/// called, taking each testcase from registers `r8` and `r9` instead of a
+/// memory buffer. The default "index" of 0 will be used. If you need multiple
+/// start harnesses compiled into the same binary, you can use the
+/// `HARNESS_START_REGISTERS2_INDEX` macro to specify different indices.
+///
+/// When this macro is called:
+///
+/// - A snapshot will be taken and saved
+/// - The initial values of the variables will be saved as the initial testcase,
+///   and the maximum testcase size will be 2 times the register width.
+/// - Each fuzzing iteration, the testcase will be split into register-width
+///   little-endian values, which are written to the registers and stored in the
+///   variables in order. No guest memory is written.
+///
+/// # Arguments
+///
+/// - `reg0`: The variable which receives the first value of each testcase
+/// - `reg1`: The variable which receives the second value of each testcase
+///
+/// # Example
+///
+/// ```
+/// unsigned long arg0 = 0, arg1 = 0;
+/// HARNESS_START_REGISTERS2(arg0, arg1);
+/// ```
+#define HARNESS_START_REGISTERS2(reg0, reg1)                         \
+  do {                                                               \
+    unsigned long long _unused2 __attribute__((unused)) = 0,         \
+                       _unused3 __attribute__((unused)) = 0;         \
+    unsigned int value = (N_START_REGISTERS << 0x10U) | MAGIC;       \
+    __cpuid_registers(value, DEFAULT_INDEX, 2, reg0, reg1, _unused2, \
+                      _unused3);                                     \
+  } while (0);
+
+/// HARNESS_START_REGISTERS2_INDEX
+///
+/// Signal the fuzzer to start the fuzzing loop at the point this macro is
+/// called, taking each testcase from registers `r8` and `r9` instead of a
+/// memory buffer. The index specified by `start_index` will be used.
+///
+/// When this macro is called:
+///
+/// - A snapshot will be taken and saved
+/// - The initial values of the variables will be saved as the initial testcase,
+///   and the maximum testcase size will be 2 times the register width.
+/// - Each fuzzing iteration, the testcase will be split into register-width
+///   little-endian values, which are written to the registers and stored in the
+///   variables in order. No guest memory is written.
+///
+/// # Arguments
+///
+/// - `start_index`: The index to use for this start harness
+/// - `reg0`: The variable which receives the first value of each testcase
+/// - `reg1`: The variable which receives the second value of each testcase
+///
+/// # Example
+///
+/// ```
+/// unsigned long arg0 = 0, arg1 = 0;
+/// HARNESS_START_REGISTERS2_INDEX(0x0001U, arg0, arg1);
+/// ```
+#define HARNESS_START_REGISTERS2_INDEX(start_index, reg0, reg1)               \
+  do {                                                                        \
+    unsigned long long _unused2 __attribute__((unused)) = 0,                  \
+                       _unused3 __attribute__((unused)) = 0;                  \
+    unsigned int value = (N_START_REGISTERS << 0x10U) | MAGIC;                \
+    __cpuid_registers(value, start_index, 2, reg0, reg1, _unused2, _unused3); \
+  } while (0);
+
+/// HARNESS_START_REGISTERS3
+///
+/// Signal the fuzzer to start the fuzzing loop at the point this macro is
+/// called, taking each testcase from registers `r8`, `r9` and `r10` instead of
+/// a memory buffer. The default "index" of 0 will be used. If you need multiple
+/// start harnesses compiled into the same binary, you can use the
+/// `HARNESS_START_REGISTERS3_INDEX` macro to specify different indices.
+///
+/// When this macro is called:
+///
+/// - A snapshot will be taken and saved
+/// - The initial values of the variables will be saved as the initial testcase,
+///   and the maximum testcase size will be 3 times the register width.
+/// - Each fuzzing iteration, the testcase will be split into register-width
+///   little-endian values, which are written to the registers and stored in the
+///   variables in order. No guest memory is written.
+///
+/// # Arguments
+///
+/// - `reg0`: The variable which receives the first value of each testcase
+/// - `reg1`: The variable which receives the second value of each testcase
+/// - `reg2`: The variable which receives the third value of each testcase
+///
+/// # Example
+///
+/// ```
+/// unsigned long arg0 = 0, arg1 = 0, arg2 = 0;
+/// HARNESS_START_REGISTERS3(arg0, arg1, arg2);
+/// ```
+#define HARNESS_START_REGISTERS3(reg0, reg1, reg2)                          \
+  do {                                                                      \
+    unsigned long long _unused3 __attribute__((unused)) = 0;                \
+    unsigned int value = (N_START_REGISTERS << 0x10U) | MAGIC;              \
+    __cpuid_registers(value, DEFAULT_INDEX, 3, reg0, reg1, reg2, _unused3); \
+  } while (0);
+
+/// HARNESS_START_REGISTERS3_INDEX
+///
+/// Signal the fuzzer to start the fuzzing loop at the point this macro is
+/// called, taking each testcase from registers `r8`, `r9` and `r10` instead of
+/// a memory buffer. The index specified by `start_index` will be used.
+///
+/// When this macro is called:
+///
+/// - A snapshot will be taken and saved
+/// - The initial values of the variables will be saved as the initial testcase,
+///   and the maximum testcase size will be 3 times the register width.
+/// - Each fuzzing iteration, the testcase will be split into register-width
+///   little-endian values, which are written to the registers and stored in the
+///   variables in order. No guest memory is written.
+///
+/// # Arguments
+///
+/// - `start_index`: The index to use for this start harness
+/// - `reg0`: The variable which receives the first value of each testcase
+/// - `reg1`: The variable which receives the second value of each testcase
+/// - `reg2`: The variable which receives the third value of each testcase
+///
+/// # Example
+///
+/// ```
+/// unsigned long arg0 = 0, arg1 = 0, arg2 = 0;
+/// HARNESS_START_REGISTERS3_INDEX(0x0001U, arg0, arg1, arg2);
+/// ```
+#define HARNESS_START_REGISTERS3_INDEX(start_index, reg0, reg1, reg2)     \
+  do {                                                                    \
+    unsigned long long _unused3 __attribute__((unused)) = 0;              \
+    unsigned int value = (N_START_REGISTERS << 0x10U) | MAGIC;            \
+    __cpuid_registers(value, start_index, 3, reg0, reg1, reg2, _unused3); \
+  } while (0);
+
+/// HARNESS_START_REGISTERS4
+///
+/// Signal the fuzzer to start the fuzzing loop at the point this macro is
+/// called, taking each testcase from registers `r8`, `r9`, `r10` and `r11`
+/// instead of a memory buffer. The default "index" of 0 will be used. If you
+/// need multiple start harnesses compiled into the same binary, you can use the
+/// `HARNESS_START_REGISTERS4_INDEX` macro to specify different indices.
+///
+/// When this macro is called:
+///
+/// - A snapshot will be taken and saved
+/// - The initial values of the variables will be saved as the initial testcase,
+///   and the maximum testcase size will be 4 times the register width.
+/// - Each fuzzing iteration, the testcase will be split into register-width
+///   little-endian values, which are written to the registers and stored in the
+///   variables in order. No guest memory is written.
+///
+/// # Arguments
+///
+/// - `reg0`: The variable which receives the first value of each testcase
+/// - `reg1`: The variable which receives the second value of each testcase
+/// - `reg2`: The variable which receives the third value of each testcase
+/// - `reg3`: The variable which receives the fourth value of each testcase
+///
+/// # Example
+///
+/// ```
+/// unsigned long arg0 = 0, arg1 = 0, arg2 = 0, arg3 = 0;
+/// HARNESS_START_REGISTERS4(arg0, arg1, arg2, arg3);
+/// ```
+#define HARNESS_START_REGISTERS4(reg0, reg1, reg2, reg3)                \
+  do {                                                                  \
+    unsigned int value = (N_START_REGISTERS << 0x10U) | MAGIC;          \
+    __cpuid_registers(value, DEFAULT_INDEX, 4, reg0, reg1, reg2, reg3); \
+  } while (0);
+
+/// HARNESS_START_REGISTERS4_INDEX
+///
+/// Signal the fuzzer to start the fuzzing loop at the point this macro is
+/// called, taking each testcase from registers `r8`, `r9`, `r10` and `r11`
+/// instead of a memory buffer. The index specified by `start_index` will be
+/// used.
+///
+/// When this macro is called:
+///
+/// - A snapshot will be taken and saved
+/// - The initial values of the variables will be saved as the initial testcase,
+///   and the maximum testcase size will be 4 times the register width.
+/// - Each fuzzing iteration, the testcase will be split into register-width
+///   little-endian values, which are written to the registers and stored in the
+///   variables in order. No guest memory is written.
+///
+/// # Arguments
+///
+/// - `start_index`: The index to use for this start harness
+/// - `reg0`: The variable which receives the first value of each testcase
+/// - `reg1`: The variable which receives the second value of each testcase
+/// - `reg2`: The variable which receives the third value of each testcase
+/// - `reg3`: The variable which receives the fourth value of each testcase
+///
+/// # Example
+///
+/// ```
+/// unsigned long arg0 = 0, arg1 = 0, arg2 = 0, arg3 = 0;
+/// HARNESS_START_REGISTERS4_INDEX(0x0001U, arg0, arg1, arg2, arg3);
+/// ```
+#define HARNESS_START_REGISTERS4_INDEX(start_index, reg0, reg1, reg2, reg3) \
+  do {                                                                      \
+    unsigned int value = (N_START_REGISTERS << 0x10U) | MAGIC;              \
+    __cpuid_registers(value, start_index, 4, reg0, reg1, reg2, reg3);       \
+  } while (0);
+
 /// Pseudo-hypercall number to signal the fuzzer to stop the current fuzzing
 /// iteration and reset to the beginning of the fuzzing loop with a "normal"
 /// stop status, indicating no solution has occurred.
@@ -474,4 +804,39 @@
     __cpuid_extended1(value, assert_index);                \
   } while (0);
 
+/// Pseudo-hypercall number to declare a guard region which the target must
+/// never access. Accesses to the region are reported as "solution" stop
+/// statuses.
+#define N_GUARD (0x0007U)
+
+/// HARNESS_GUARD
+///
+/// Declare a guard region, for example a redzone between two objects or after
+/// the end of a buffer. Writes to the region (and reads, if the fuzzer is
+/// configured to guard reads) stop the current fuzzing iteration with a
+/// "solution" stop status. Guard regions declared before the start harness
+/// persist for the rest of the fuzzing campaign, and guard regions declared
+/// after it are removed when the iteration ends, so regions on the stack of one
+/// iteration do not affect the next. Declaring the same region more than once
+/// has no effect. Unlike the start and stop harnesses, this harness does not
+/// stop the simulation.
+///
+/// # Arguments
+///
+/// - `addr`: The address of the start of the guard region
+/// - `len`: The size of the guard region in bytes
+///
+/// # Example
+///
+/// ```
+/// char buffer[0x100];
+/// char redzone[0x10];
+/// HARNESS_GUARD(redzone, sizeof(redzone));
+/// ```
+#define HARNESS_GUARD(addr, len)                             \
+  do {                                                       \
+    unsigned int value = (N_GUARD << 0x10U) | MAGIC;         \
+    __cpuid_extended3(value, DEFAULT_INDEX, addr, len);      \
+  } while (0);
+
 #endif  // TSFFS_H
\ No newline at end of file
@@ -0,0 +1,242 @@
+// Copyright (C) 2024 Intel Corporation
+// SPDX-License-Identifier: Apache-2.0
+
+//! Parallel gzip compression for package archives
+
+use crc32fast::Hasher;
+use flate2::{write::DeflateEncoder, Compression};
+use std::{
+    io::{Error, ErrorKind, Result, Write},
+    mem::take,
+    num::NonZeroUsize,
+    thread::{available_parallelism, scope},
+};
+
+/// A gzip encoder which splits its input into fixed size blocks and compresses up to one block
+/// per thread in parallel. Each block is compressed as raw deflate data ending in a sync flush,
+/// so the blocks can be concatenated into the body of a single gzip member whose checksum is
+/// combined from the checksums of each block. The output is a single member, so readers which
+/// stop after the first member still see the whole input. At most `threads` blocks of input are
+/// held in memory at once.
+pub struct ParallelGzEncoder<W>
+where
+    W: Write,
+{
+    /// The writer the compressed member is written to
+    inner: W,
+    /// The compression level used for each block
+    level: Compression,
+    /// The size of each block of input
+    block_size: usize,
+    /// The number of blocks to compress in parallel
+    threads: usize,
+    /// Full blocks waiting to be compressed
+    blocks: Vec<Vec<u8>>,
+    /// The block currently being filled
+    current: Vec<u8>,
+    /// Whether the gzip header has been written to the inner writer
+    header_written: bool,
+    /// The checksum of all input compressed so far
+    crc: Hasher,
+    /// The size of all input compressed so far, modulo 2^32
+    size: u32,
+}
+
+impl<W> ParallelGzEncoder<W>
+where
+    W: Write,
+{
+    /// The default size of each compressed block
+    pub const DEFAULT_BLOCK_SIZE: usize = 1024 * 1024;
+    /// A gzip header with no file name, modification time, or extra fields and an unknown OS
+    const GZIP_HEADER: [u8; 10] = [0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff];
+    /// An empty final deflate block with fixed Huffman codes, which ends the deflate stream
+    const DEFLATE_END: [u8; 2] = [0x03, 0x00];
+
+    /// Create a new encoder writing to `inner` using one thread per available CPU
+    pub fn new(inner: W, level: Compression) -> Self {
+        let threads = available_parallelism().map(NonZeroUsize::get).unwrap_or(1);
+
+        Self::with_options(inner, level, Self::DEFAULT_BLOCK_SIZE, threads)
+    }
+
+    /// Create a new encoder writing to `inner` with a specific block size and thread count
+    pub fn with_options(inner: W, level: Compression, block_size: usize, threads: usize) -> Self {
+        let block_size = block_size.max(1);
+
+        Self {
+            inner,
+            level,
+            block_size,
+            threads: threads.max(1),
+            blocks: Vec::new(),
+            current: Vec::with_capacity(block_size),
+            header_written: false,
+            crc: Hasher::new(),
+            size: 0,
+        }
+    }
+
+    /// Write the gzip header to the inner writer if it has not been written yet
+    fn write_header(&mut self) -> Result<()> {
+        if !self.header_written {
+            self.inner.write_all(&Self::GZIP_HEADER)?;
+            self.header_written = true;
+        }
+
+        Ok(())
+    }
+
+    /// Compress all full blocks in parallel and write them to the inner writer in order
+    fn compress_blocks(&mut self) -> Result<()> {
+        if self.blocks.is_empty() {
+            return Ok(());
+        }
+
+        let level = self.level;
+        let blocks = take(&mut self.blocks);
+
+        let compressed = scope(|s| {
+            blocks
+                .iter()
+                .map(|block| {
+                    s.spawn(move || {
+                        let mut crc = Hasher::new();
+                        crc.update(block);
+                        // Each block is flushed but not finished, so the deflate stream stays
+                        // open and the next block's data can follow it directly
+                        let mut encoder =
+                            DeflateEncoder::new(Vec::with_capacity(block.len() / 2), level);
+                        encoder.write_all(block)?;
+                        Ok((encoder.flush_finish()?, crc))
+                    })
+                })
+                .collect::<Vec<_>>()
+                .into_iter()
+                .map(|handle| {
+                    handle.join().unwrap_or_else(|_| {
+                        Err(Error::new(ErrorKind::Other, "Compression thread panicked"))
+                    })
+                })
+                .collect::<Result<Vec<_>>>()
+        })?;
+
+        self.write_header()?;
+
+        blocks
+            .iter()
+            .zip(compressed)
+            .try_for_each(|(block, (data, crc))| {
+                self.inner.write_all(&data)?;
+                self.crc.combine(&crc);
+                // ISIZE is defined as the input size modulo 2^32, so truncation is intended
+                self.size = self.size.wrapping_add(block.len() as u32);
+                Ok(())
+            })
+    }
+
+    /// Compress any remaining input, end the gzip member, and return the inner writer
+    pub fn finish(mut self) -> Result<W> {
+        if !self.current.is_empty() {
+            let current = take(&mut self.current);
+            self.blocks.push(current);
+        }
+
+        self.compress_blocks()?;
+        // An empty input still needs a header to be a valid gzip stream
+        self.write_header()?;
+        self.inner.write_all(&Self::DEFLATE_END)?;
+        self.inner
+            .write_all(&self.crc.clone().finalize().to_le_bytes())?;
+        self.inner.write_all(&self.size.to_le_bytes())?;
+        self.inner.flush()?;
+
+        Ok(self.inner)
+    }
+}
+
+impl<W> Write for ParallelGzEncoder<W>
+where
+    W: Write,
+{
+    fn write(&mut self, buf: &[u8]) -> Result<usize> {
+        let len = buf.len().min(self.block_size - self.current.len());
+        self.current.extend_from_slice(&buf[..len]);
+
+        if self.current.len() == self.block_size {
+            let current = take(&mut self.current);
+            self.blocks.push(current);
+            self.current = Vec::with_capacity(self.block_size);
+
+            if self.blocks.len() == self.threads {
+                self.compress_blocks()?;
+            }
+        }
+
+        Ok(len)
+    }
+
+    fn flush(&mut self) -> Result<()> {
+        // Partial blocks are not compressed early, because doing so would shrink the blocks and
+        // reduce the compression ratio. Only the full blocks are written out.
+        self.compress_blocks()?;
+        self.inner.flush()
+    }
+}
+
+#[cfg(test)]
+mod tests {
+    use super::ParallelGzEncoder;
+    use flate2::{read::GzDecoder, Compression};
+    use std::io::{Read, Result, Write};
+
+    /// Compress `input` with the parallel encoder and decompress it with a reader which only
+    /// reads the first gzip member
+    fn round_trip(input: &[u8], block_size: usize, threads: usize) -> Result<Vec<u8>> {
+        let mut encoder = ParallelGzEncoder::with_options(
+            Vec::new(),
+            Compression::default(),
+            block_size,
+            threads,
+        );
+        encoder.write_all(input)?;
+        let compressed = encoder.finish()?;
+
+        let mut output = Vec::new();
+        GzDecoder::new(compressed.as_slice()).read_to_end(&mut output)?;
+        Ok(output)
+    }
+
+    fn input(len: usize) -> Vec<u8> {
+        (0..len).map(|i| (i * 7 % 251) as u8).collect()
+    }
+
+    #[test]
+    fn test_round_trip_empty() -> Result<()> {
+        assert!(round_trip(&[], 16, 4)?.is_empty());
+        Ok(())
+    }
+
+    #[test]
+    fn test_round_trip_single_block() -> Result<()> {
+        let input = input(100);
+        assert_eq!(round_trip(&input, 1024, 4)?, input);
+        Ok(())
+    }
+
+    #[test]
+    fn test_round_trip_many_blocks() -> Result<()> {
+        // More blocks than threads, with a partial final block, so several batches are written
+        let input = input(64 * 1024 + 17);
+        assert_eq!(round_trip(&input, 4096, 3)?, input);
+        Ok(())
+    }
+
+    #[test]
+    fn test_round_trip_exact_blocks() -> Result<()> {
+        // No partial final block, so the stream ends after an already written batch
+        let input = input(8 * 1024);
+        assert_eq!(round_trip(&input, 1024, 2)?, input);
+        Ok(())
+    }
+}
@@ -6,12 +6,14 @@
 #![deny(missing_docs)]
 
 pub mod artifacts;
+pub mod compress;
 pub mod error;
 pub mod package;
 pub mod spec;
 pub mod util;
 
 pub use artifacts::*;
+pub use compress::*;
 pub use error::*;
 pub use package::*;
 pub use spec::*;
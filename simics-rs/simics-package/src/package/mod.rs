@@ -4,13 +4,16 @@
 //! An ISPM package which can be built from a subcommand invocation and output to a directory
 //! on disk.
 
-use crate::{Error, IspmMetadata, PackageArtifacts, PackageInfo, PackageSpec, Result};
+use crate::{
+    Error, IspmMetadata, PackageArtifacts, PackageInfo, PackageSpec, ParallelGzEncoder, Result,
+};
 use cargo_subcommand::Subcommand;
 use flate2::{write::GzEncoder, Compression};
 #[cfg(unix)]
 use std::time::SystemTime;
 use std::{
-    fs::write,
+    fs::{remove_file, File},
+    io::{BufReader, BufWriter, Write},
     path::{Path, PathBuf},
 };
 use tar::{Builder, Header};
@@ -148,10 +151,14 @@ impl Package {
         Ok(())
     }
 
-    /// Create the inner package.tar.gz tarball which expands to the simics package.
-    pub fn create_inner_tarball(&self) -> Result<(Vec<u8>, usize)> {
-        let tar_gz = Vec::new();
-        let encoder = GzEncoder::new(tar_gz, Compression::new(Self::COMPRESSION_LEVEL));
+    /// Create the inner package.tar.gz tarball which expands to the simics package, streaming
+    /// it to `writer` with blocks compressed in parallel. Returns the writer and the
+    /// uncompressed size of the package contents.
+    pub fn create_inner_tarball<W>(&self, writer: W) -> Result<(W, usize)>
+    where
+        W: Write,
+    {
+        let encoder = ParallelGzEncoder::new(writer, Compression::new(Self::COMPRESSION_LEVEL));
         let mut tar = Builder::new(encoder);
         // The uncompressed size is used by simics, and must be calculated the way simics
         // expects
@@ -184,13 +191,22 @@ impl Package {
         Ok((tar.into_inner()?.finish()?, uncompressed_size))
     }
 
-    /// Create the outer tarball (actually an ISPM package) containing the inner package and a
-    /// metadata file used by ISPM
-    pub fn create_tarball(&self) -> Result<Vec<u8>> {
-        let tar_gz = Vec::new();
-        let encoder = GzEncoder::new(tar_gz, Compression::new(Self::COMPRESSION_LEVEL));
+    /// Create the outer tarball (actually an ISPM package) containing the inner package read
+    /// from `inner_tarball` and a metadata file used by ISPM, streaming it to `writer`. The
+    /// inner package is already compressed, so the outer gzip stream stores it without
+    /// compressing it again.
+    pub fn create_tarball<P, W>(
+        &self,
+        inner_tarball: P,
+        uncompressed_size: usize,
+        writer: W,
+    ) -> Result<W>
+    where
+        P: AsRef<Path>,
+        W: Write,
+    {
+        let encoder = GzEncoder::new(writer, Compression::none());
         let mut tar = Builder::new(encoder);
-        let (inner_tarball, uncompressed_size) = self.create_inner_tarball()?;
 
         let mut ispm_metadata = IspmMetadata::from(&self.spec);
         // This size should be exactly equal to the total size of the files in the inner tarball
@@ -209,13 +225,14 @@ impl Package {
             ispm_metadata_data,
         )?;
 
+        let inner_tarball = File::open(inner_tarball.as_ref())?;
         let mut inner_tarball_header = Header::new_gnu();
-        inner_tarball_header.set_size(inner_tarball.len() as u64);
+        inner_tarball_header.set_size(inner_tarball.metadata()?.len());
         Self::set_header_common(&mut inner_tarball_header)?;
         tar.append_data(
             &mut inner_tarball_header,
             Self::INNER_PACKAGE_FILENAME,
-            inner_tarball.as_slice(),
+            BufReader::new(inner_tarball),
         )?;
 
         tar.finish()?;
@@ -223,6 +240,24 @@ impl Package {
         Ok(tar.into_inner()?.finish()?)
     }
 
+    /// Write the package to `path`, staging the inner tarball in `inner_path`
+    fn write_package(&self, path: &Path, inner_path: &Path) -> Result<()> {
+        let (inner, uncompressed_size) =
+            self.create_inner_tarball(BufWriter::new(File::create(inner_path)?))?;
+        inner.into_inner().map_err(|e| e.into_error())?.sync_all()?;
+
+        self.create_tarball(
+            inner_path,
+            uncompressed_size,
+            BufWriter::new(File::create(path)?),
+        )?
+        .into_inner()
+        .map_err(|e| e.into_error())?
+        .sync_all()?;
+
+        Ok(())
+    }
+
     /// Build the package, writing it to the directory specified by `output` and returning
     /// the path to the package
     pub fn build<P>(&mut self, output: P) -> Result<PathBuf>
@@ -246,12 +281,26 @@ impl Package {
             Ok::<(), Error>(())
         })?;
 
-        let tarball = self.create_tarball()?;
         let path = output.as_ref().join(self.package_filename());
-
-        write(&path, tarball).map_err(|e| Error::WritePackageError {
-            path: path.clone(),
-            source: e,
+        // The inner tarball must be complete before the outer tarball can be written, because
+        // its size is needed for its header and the uncompressed size is needed for the
+        // metadata which precedes it. It is staged next to the package instead of in memory.
+        let inner_path = output.as_ref().join(format!(
+            "{}.{}",
+            self.package_filename(),
+            Self::INNER_PACKAGE_FILENAME
+        ));
+
+        let result = self.write_package(&path, &inner_path);
+        // The staged inner tarball is removed whether or not writing the package succeeded
+        let _ = remove_file(&inner_path);
+
+        result.map_err(|e| match e {
+            Error::IoError(source) => Error::WritePackageError {
+                path: path.clone(),
+                source,
+            },
+            e => e,
         })?;
 
         Ok(path)
@@ -20,11 +20,17 @@ use ispm_wrapper::{
     Internal,
 };
 use std::{
-    collections::HashSet,
+    collections::{hash_map::DefaultHasher, HashSet},
     env::{current_dir, set_current_dir, var},
-    fs::{copy, create_dir_all, read_dir, remove_dir_all, write},
+    fs::{
+        copy, create_dir_all, hard_link, read_dir, read_to_string, remove_dir_all, remove_file,
+        write, OpenOptions,
+    },
+    hash::{Hash, Hasher},
+    io::ErrorKind,
     path::{Path, PathBuf},
     process::{Command, Output},
+    time::UNIX_EPOCH,
 };
 use typed_builder::TypedBuilder;
 use versions::{Requirement, Versioning};
@@ -36,6 +42,20 @@ pub const SIMICS_TEST_CLEANUP_EACH_ENV: &str = "SIMICS_TEST_CLEANUP_EACH";
 /// An environment variable which, if set, causes package installation to default to local installation
 /// only
 pub const SIMICS_TEST_LOCAL_PACKAGES_ONLY_ENV: &str = "SIMICS_TEST_LOCAL_PACKAGES_ONLY";
+/// An environment variable which, if set, disables the cache of prepared project templates and
+/// causes each test environment to install its packages and create its project from scratch
+pub const SIMICS_TEST_NO_CACHE_ENV: &str = "SIMICS_TEST_NO_CACHE";
+/// The name of the directory in the test base directory containing prepared project templates
+pub const SIMICS_TEST_CACHE_DIRNAME: &str = "simics-test-cache";
+/// The name of the marker file written into a cached template once it is completely prepared
+const SIMICS_TEST_CACHE_COMPLETE_FILENAME: &str = ".simics-test-complete";
+/// The name of the lock file in the cache directory which serializes preparing, linking from
+/// and pruning cached templates across all test processes
+const SIMICS_TEST_CACHE_LOCK_FILENAME: &str = ".simics-test-lock";
+/// The name of the file in a cached template containing the key of its specification without
+/// the hashes of its package crates. Templates with the same family are prepared from older
+/// sources of the same package crates and are pruned when a new one is prepared.
+const SIMICS_TEST_CACHE_FAMILY_FILENAME: &str = ".simics-test-family";
 
 /// Copy the contents of one directory to another, recursively, overwriting files if they exist but
 /// without replacing directories or their contents if they already exist
@@ -76,6 +96,10 @@ where
                 )
             })?;
         } else if src.is_file() {
+            // The destination may be hard linked into a cached template, so it is replaced
+            // rather than overwritten in place
+            let _ = remove_file(&dst);
+
             if let Err(e) = copy(&src, &dst) {
                 eprintln!(
                     "Warning: failed to copy file from {} to {}: {}",
@@ -89,6 +113,46 @@ where
     Ok(())
 }
 
+/// Recreate the contents of one directory in another, recursively, hard linking files instead of
+/// copying them where possible. Files which cannot be linked, for example because the
+/// directories are on different filesystems, are copied instead.
+pub fn link_dir_contents<P>(src_dir: P, dst_dir: P) -> Result<()>
+where
+    P: AsRef<Path>,
+{
+    let src_dir = src_dir.as_ref().to_path_buf();
+    ensure!(src_dir.is_dir(), "Source must be a directory");
+    let dst_dir = dst_dir.as_ref().to_path_buf();
+
+    for entry in WalkDir::new(&src_dir).into_iter().filter_map(|p| p.ok()) {
+        let src = entry.path();
+        let Ok(suffix) = src.strip_prefix(&src_dir) else {
+            continue;
+        };
+        let dst = dst_dir.join(suffix);
+
+        if entry.file_type().is_dir() {
+            create_dir_all(&dst).map_err(|e| {
+                anyhow!(
+                    "Failed to create nested destination directory for link {:?}: {}",
+                    dst,
+                    e
+                )
+            })?;
+        } else if entry.file_type().is_symlink() {
+            #[cfg(unix)]
+            std::os::unix::fs::symlink(std::fs::read_link(src)?, &dst)
+                .map_err(|e| anyhow!("Failed to recreate symlink {:?}: {}", dst, e))?;
+            #[cfg(not(unix))]
+            copy(src, &dst).map_err(|e| anyhow!("Failed to copy {:?}: {}", src, e))?;
+        } else if hard_link(src, &dst).is_err() {
+            copy(src, &dst).map_err(|e| anyhow!("Failed to copy {:?} to {:?}: {}", src, dst, e))?;
+        }
+    }
+
+    Ok(())
+}
+
 /// Abstract install procedure for public and internal ISPM
 pub fn local_or_remote_pkg_install(mut options: InstallOptions) -> Result<()> {
     if Internal::is_internal()? && var(SIMICS_TEST_LOCAL_PACKAGES_ONLY_ENV).is_err() {
@@ -243,6 +307,9 @@ impl TestEnv {
                     create_dir_all(target_parent)?;
                 }
             }
+            // The target may be hard linked into a cached template, so it is replaced rather
+            // than overwritten in place
+            let _ = remove_file(&target);
             write(target, content)?;
         }
 
@@ -269,15 +336,185 @@ impl TestEnv {
         Ok(())
     }
 
+    /// Hash the sources of a package crate by the path, size and modification time of each
+    /// file, skipping build output and version control directories
+    fn module_hash<P>(crate_dir: P) -> Result<u64>
+    where
+        P: AsRef<Path>,
+    {
+        let mut hasher = DefaultHasher::new();
+
+        for entry in WalkDir::new(crate_dir.as_ref())
+            .sort_by_file_name()
+            .into_iter()
+            .filter_entry(|e| {
+                !(e.file_type().is_dir() && (e.file_name() == "target" || e.file_name() == ".git"))
+            })
+            .filter_map(|p| p.ok())
+            .filter(|p| p.file_type().is_file())
+        {
+            let metadata = entry.metadata()?;
+            entry.path().hash(&mut hasher);
+            metadata.len().hash(&mut hasher);
+            metadata
+                .modified()?
+                .duration_since(UNIX_EPOCH)?
+                .as_nanos()
+                .hash(&mut hasher);
+        }
+
+        Ok(hasher.finish())
+    }
+
+    /// The family of the cached template for a specification, derived from the set of
+    /// packages it installs and the package crates it builds, but not their contents
+    fn template_family(spec: &TestEnvSpec) -> u64 {
+        let mut hasher = DefaultHasher::new();
+
+        [&spec.packages, &spec.nonrepo_packages]
+            .iter()
+            .for_each(|packages| {
+                let mut packages = packages.iter().map(|p| p.to_string()).collect::<Vec<_>>();
+                packages.sort();
+                packages.hash(&mut hasher);
+            });
+        spec.package_repo.hash(&mut hasher);
+        spec.install_all.hash(&mut hasher);
+        cfg!(debug_assertions).hash(&mut hasher);
+        spec.package_crates.hash(&mut hasher);
+
+        hasher.finish()
+    }
+
+    /// The key of the cached template for a specification, derived from its family and the
+    /// hashes of the package crates it builds
+    fn template_key(spec: &TestEnvSpec) -> Result<u64> {
+        let mut hasher = DefaultHasher::new();
+
+        Self::template_family(spec).hash(&mut hasher);
+
+        for package_crate in &spec.package_crates {
+            Self::module_hash(package_crate)?.hash(&mut hasher);
+        }
+
+        Ok(hasher.finish())
+    }
+
+    /// Remove the cached templates in `cache_dir` of the same family as `template_dir`, which
+    /// were prepared from older sources of its package crates and will not be used again
+    fn prune_cached_templates<P>(cache_dir: P, template_dir: P, family: &str) -> Result<()>
+    where
+        P: AsRef<Path>,
+    {
+        for entry in read_dir(cache_dir.as_ref())?.filter_map(|e| e.ok()) {
+            let path = entry.path();
+
+            if path == template_dir.as_ref()
+                || !read_to_string(path.join(SIMICS_TEST_CACHE_FAMILY_FILENAME))
+                    .is_ok_and(|f| f == family)
+            {
+                continue;
+            }
+
+            if let Err(e) = remove_dir_all(&path) {
+                eprintln!(
+                    "Warning: failed to remove stale cached template {}: {}",
+                    path.display(),
+                    e
+                );
+            }
+        }
+
+        Ok(())
+    }
+
+    /// Call `f` with the directory of the cached template for a specification, preparing it
+    /// first if it does not exist. The template contains a `simics` home directory with the
+    /// packages of the specification installed and a `project` directory created with them.
+    ///
+    /// The cache is locked with a file lock for the duration of the call, so tests in other
+    /// processes, such as other test binaries run in parallel, cannot prepare or prune a
+    /// template while `f` links from it.
+    fn with_cached_template<P, F, T>(spec: &TestEnvSpec, test_base: P, f: F) -> Result<T>
+    where
+        P: AsRef<Path>,
+        F: FnOnce(&Path) -> Result<T>,
+    {
+        let cache_dir = test_base.as_ref().join(SIMICS_TEST_CACHE_DIRNAME);
+        let family = format!("{:016x}", Self::template_family(spec));
+        let template_dir = cache_dir.join(format!("{:016x}", Self::template_key(spec)?));
+
+        create_dir_all(&cache_dir).map_err(|e| {
+            anyhow!(
+                "Could not create template cache directory {:?}: {}",
+                cache_dir,
+                e
+            )
+        })?;
+
+        // The lock is released when the file is closed, including when a test panics or its
+        // process exits while holding it
+        let lock = OpenOptions::new()
+            .create(true)
+            .truncate(false)
+            .write(true)
+            .open(cache_dir.join(SIMICS_TEST_CACHE_LOCK_FILENAME))?;
+        lock.lock()?;
+
+        if !template_dir
+            .join(SIMICS_TEST_CACHE_COMPLETE_FILENAME)
+            .is_file()
+        {
+            Self::prepare_cached_template(spec, &template_dir)?;
+            write(
+                template_dir.join(SIMICS_TEST_CACHE_FAMILY_FILENAME),
+                &family,
+            )?;
+            write(template_dir.join(SIMICS_TEST_CACHE_COMPLETE_FILENAME), [])?;
+            Self::prune_cached_templates(&cache_dir, &template_dir, &family)?;
+        }
+
+        f(&template_dir)
+    }
+
+    /// Prepare the cached template in `template_dir`, removing any incomplete template left
+    /// there by an earlier failure
+    fn prepare_cached_template(spec: &TestEnvSpec, template_dir: &Path) -> Result<()> {
+        // A template without the marker was left incomplete by an earlier failure
+        remove_dir_all(&template_dir).or_else(|e| {
+            if e.kind() == ErrorKind::NotFound {
+                Ok(())
+            } else {
+                Err(e)
+            }
+        })?;
+
+        let simics_home_dir = template_dir.join("simics");
+
+        create_dir_all(&simics_home_dir).map_err(|e| {
+            anyhow!(
+                "Could not create simics home directory: {:?}: {}",
+                simics_home_dir,
+                e
+            )
+        })?;
+
+        Self::prepare(spec, &simics_home_dir, &template_dir.join("project"))
+    }
+
     fn build(spec: &TestEnvSpec) -> Result<Self> {
         let test_base = PathBuf::from(&spec.cargo_target_tmpdir);
         let test_dir = test_base.join(&spec.name);
 
         let project_dir = test_dir.join("project");
 
+        // Environments using the default simics home are instantiated from a cached template
+        // by linking its project, and share its simics home. Environments with an explicit
+        // simics home install into it directly.
         let simics_home_dir = if let Some(simics_home) = spec.simics_home.as_ref() {
+            Self::prepare(spec, simics_home, &project_dir)?;
             simics_home.clone()
-        } else {
+        } else if var(SIMICS_TEST_NO_CACHE_ENV).is_ok() {
             create_dir_all(test_dir.join("simics")).map_err(|e| {
                 anyhow!(
                     "Could not create simics home directory: {:?}: {}",
@@ -286,9 +523,53 @@ impl TestEnv {
                 )
             })?;
 
+            Self::prepare(spec, &test_dir.join("simics"), &project_dir)?;
             test_dir.join("simics")
+        } else {
+            Self::with_cached_template(spec, &test_base, |template_dir| {
+                Self::remove_project_dir(&project_dir)?;
+                link_dir_contents(template_dir.join("project"), project_dir.clone())?;
+                Ok(template_dir.join("simics"))
+            })?
         };
 
+        Self::install_files(&project_dir, &spec.files)?;
+        Self::install_directories(&project_dir, &spec.directories)?;
+
+        Ok(Self {
+            test_base,
+            test_dir,
+            project_dir,
+            simics_home_dir,
+        })
+    }
+
+    /// Remove an existing project directory, if there is one
+    fn remove_project_dir<P>(project_dir: P) -> Result<()>
+    where
+        P: AsRef<Path>,
+    {
+        remove_dir_all(project_dir.as_ref()).or_else(|e| {
+            if e.to_string().contains("No such file or directory") {
+                Ok(())
+            } else {
+                Err(e)
+            }
+        })?;
+
+        Ok(())
+    }
+
+    /// Install the packages and package crates of a specification into a simics home
+    /// directory and create a project with them. The files and directories of the
+    /// specification are not installed into the project.
+    fn prepare<P>(spec: &TestEnvSpec, simics_home_dir: P, project_dir: P) -> Result<()>
+    where
+        P: AsRef<Path>,
+    {
+        let simics_home_dir = simics_home_dir.as_ref().to_path_buf();
+        let project_dir = project_dir.as_ref().to_path_buf();
+
         // Install nonrepo packages which do not use a possibly-provided package repo
         if !spec.nonrepo_packages.is_empty() {
             local_or_remote_pkg_install(
@@ -485,13 +766,7 @@ impl TestEnv {
         set_current_dir(&initial_dir)
             .map_err(|e| anyhow!("Failed to set current directory to {initial_dir:?}: {e}"))?;
 
-        remove_dir_all(&project_dir).or_else(|e| {
-            if e.to_string().contains("No such file or directory") {
-                Ok(())
-            } else {
-                Err(e)
-            }
-        })?;
+        Self::remove_project_dir(&project_dir)?;
 
         // Create the project using the installed packages
         ispm::projects::create(
@@ -508,15 +783,7 @@ impl TestEnv {
             &project_dir,
         )?;
 
-        Self::install_files(&project_dir, &spec.files)?;
-        Self::install_directories(&project_dir, &spec.directories)?;
-
-        Ok(Self {
-            test_base,
-            test_dir,
-            project_dir,
-            simics_home_dir,
-        })
+        Ok(())
     }
 
     /// Clean up the test environment
@@ -3,7 +3,25 @@
 
 //! Memory transactions
 
-use crate::sys::generic_transaction_t;
+use crate::{sys::generic_transaction_t, PhysicalAddress};
 
 /// Alias for `generic_transaction_t`
 pub type GenericTransaction = generic_transaction_t;
+
+/// Get the physical address of the first byte accessed by a memory transaction
+///
+/// # Safety
+///
+/// `mop` must point to a valid memory transaction
+pub unsafe fn get_mem_op_physical_address(mop: *mut GenericTransaction) -> PhysicalAddress {
+    (*mop).physical_address
+}
+
+/// Get the size in bytes of a memory transaction
+///
+/// # Safety
+///
+/// `mop` must point to a valid memory transaction
+pub unsafe fn get_mem_op_size(mop: *mut GenericTransaction) -> u32 {
+    (*mop).size
+}
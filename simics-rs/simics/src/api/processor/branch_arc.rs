@@ -0,0 +1,74 @@
+// Copyright (C) 2024 Intel Corporation
+// SPDX-License-Identifier: Apache-2.0
+
+//! Branch recorder arc iteration
+
+use crate::{
+    get_interface, object_name,
+    sys::{branch_arc_iter_t, branch_arc_t, branch_arc_type_t, branch_recorder_direction_t},
+    BranchArcInterface, ConfObject, Error, GenericAddress, Result,
+};
+
+/// Alias for `branch_arc_t`
+pub type BranchArc = branch_arc_t;
+/// Alias for `branch_arc_type_t`
+pub type BranchArcType = branch_arc_type_t;
+/// Alias for `branch_recorder_direction_t`
+pub type BranchRecorderDirection = branch_recorder_direction_t;
+
+/// An owned iterator over the arcs recorded by a branch recorder. Each item is a copy of the
+/// recorded arc, and the underlying Simics iterator is destroyed when this iterator is dropped.
+pub struct BranchArcIter {
+    iter: *mut branch_arc_iter_t,
+}
+
+impl Iterator for BranchArcIter {
+    type Item = BranchArc;
+
+    fn next(&mut self) -> Option<Self::Item> {
+        let next = unsafe { (*self.iter).next }?;
+        let arc = unsafe { next(self.iter) };
+
+        if arc.is_null() {
+            None
+        } else {
+            Some(unsafe { *arc })
+        }
+    }
+}
+
+impl Drop for BranchArcIter {
+    fn drop(&mut self) {
+        if let Some(destroy) = unsafe { (*self.iter).destroy } {
+            unsafe { destroy(self.iter) };
+        }
+    }
+}
+
+/// Iterate over the arcs recorded by the branch recorder `recorder` whose source (for
+/// `BR_Direction_From`) or destination (for `BR_Direction_To`) address lies in the range
+/// `[start, stop]`.
+///
+/// # Arguments
+///
+/// * `recorder` - A branch recorder object implementing the `branch_arc` interface
+/// * `start` - The first address of the range to iterate over
+/// * `stop` - The last address of the range to iterate over
+/// * `dir` - Whether `start` and `stop` bound the source or destination of each arc
+pub fn branch_arcs(
+    recorder: *mut ConfObject,
+    start: GenericAddress,
+    stop: GenericAddress,
+    dir: BranchRecorderDirection,
+) -> Result<BranchArcIter> {
+    let mut branch_arc: BranchArcInterface = get_interface(recorder)?;
+    let iter = branch_arc.iter(start, stop, dir)?;
+
+    if iter.is_null() {
+        Err(Error::NoBranchArcIterator {
+            object: object_name(recorder).unwrap_or_default(),
+        })
+    } else {
+        Ok(BranchArcIter { iter })
+    }
+}
@@ -3,10 +3,12 @@
 
 //! Processor APIs
 
+pub mod branch_arc;
 pub mod context;
 pub mod stc;
 pub mod types;
 
+pub use branch_arc::*;
 pub use context::*;
 pub use stc::*;
 pub use types::*;
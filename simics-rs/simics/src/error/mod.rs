@@ -227,6 +227,12 @@ pub enum Error {
         /// The file
         library_type: String,
     },
+    #[error("Branch arc iterator for {object} could not be created")]
+    /// A branch recorder returned no iterator over its recorded arcs
+    NoBranchArcIterator {
+        /// The name of the branch recorder object
+        object: String,
+    },
     #[error("File matching pattern {pattern} not found in directory {directory:?}")]
     /// A file could not be found matching a given pattern
     FileNotFoundInDirectory {
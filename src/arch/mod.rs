@@ -22,12 +22,23 @@ use simics::{
     },
     read_byte,
 };
-use std::{fmt::Debug, str::FromStr};
+use std::{
+    collections::{BTreeMap, HashSet},
+    ffi::CStr,
+    fmt::Debug,
+    mem::size_of,
+    slice::from_raw_parts,
+    str::FromStr,
+};
 
 pub mod risc_v;
 pub mod x86;
 pub mod x86_64;
 
+/// The page size used to split guard regions into physically contiguous ranges. This is the
+/// smallest page size of every supported architecture.
+const GUARD_PAGE_SIZE: u64 = 4096;
+
 #[derive(Debug, Clone)]
 /// An architecture hint that can be parsed from a string
 pub(crate) enum ArchitectureHint {
@@ -109,6 +120,29 @@ pub trait ArchitectureOperations {
     const ARGUMENT_REGISTER_1: &'static str;
     const ARGUMENT_REGISTER_2: &'static str;
     const POINTER_WIDTH_OVERRIDE: Option<i32> = None;
+    /// The register holding the processor's interrupt enable bits
+    const INTERRUPT_ENABLE_REGISTER: &'static str;
+    /// The interrupt enable bits of `INTERRUPT_ENABLE_REGISTER` which mask interrupts when clear
+    const INTERRUPT_ENABLE_MASK: u64;
+    /// The register holding the root of the current address space's page tables
+    const ADDRESS_SPACE_REGISTER: &'static str;
+    /// The bits of `ADDRESS_SPACE_REGISTER` holding the page table root. The other bits tag or
+    /// configure the address space, and may change while the same page tables are in use
+    const ADDRESS_SPACE_MASK: u64;
+    /// The registers, in order, which a harness taking its input in registers may have
+    /// fuzzed. None of them may be written by the magic instruction itself
+    const INPUT_REGISTERS: &'static [&'static str];
+    /// The register holding the frame pointer, used to walk the call stack
+    const FRAME_POINTER_REGISTER: &'static str;
+    /// The pointer-sized slot, relative to the frame pointer, holding the caller's frame
+    /// pointer
+    const FRAME_POINTER_SLOT: i64;
+    /// The pointer-sized slot, relative to the frame pointer, holding the return address
+    const RETURN_ADDRESS_SLOT: i64;
+    /// The register holding the address which caused the last memory access fault
+    const FAULT_ADDRESS_REGISTER: &'static str;
+    /// The exception numbers which write the faulting address to `FAULT_ADDRESS_REGISTER`
+    const FAULT_EXCEPTIONS: &'static [i64];
 
     /// Create a new instance of the architecture operations
     fn new(cpu: *mut ConfObject) -> Result<Self>
@@ -354,6 +388,60 @@ pub trait ArchitectureOperations {
             .build())
     }
 
+    /// Get the magic start information from the harness which takes the arguments:
+    ///
+    /// - count: The number of `INPUT_REGISTERS` each testcase is written to
+    fn get_magic_start_registers(&mut self) -> Result<StartInfo> {
+        let count_register_number = self
+            .int_register()
+            .get_number(Self::ARGUMENT_REGISTER_0.as_raw_cstr()?)?;
+        let count = self.int_register().read(count_register_number)? as usize;
+
+        ensure!(
+            (1..=Self::INPUT_REGISTERS.len()).contains(&count),
+            "Invalid register count found in magic start count register {count_register_number}: {count} (must be between 1 and {})",
+            Self::INPUT_REGISTERS.len()
+        );
+
+        let register_size = if let Some(width) = Self::POINTER_WIDTH_OVERRIDE {
+            width as usize
+        } else {
+            self.processor_info_v2().get_logical_address_width()? as usize / u8::BITS as usize
+        };
+
+        let registers = Self::INPUT_REGISTERS
+            .iter()
+            .take(count)
+            .map(|r| r.to_string())
+            .collect::<Vec<_>>();
+
+        // The initial contents are the values the registers hold when the harness starts,
+        // unless the input registers also carry the magic arguments, in which case they hold
+        // the start index and register count and the initial contents are zero
+        let contents = if registers
+            .iter()
+            .any(|r| r == Self::INDEX_SELECTOR_REGISTER || r == Self::ARGUMENT_REGISTER_0)
+        {
+            vec![0; count * register_size]
+        } else {
+            registers
+                .iter()
+                .map(|r| -> Result<Vec<u8>> {
+                    let number = self.int_register().get_number(r.as_raw_cstr()?)?;
+                    let value = self.int_register().read(number)?;
+                    Ok(value.to_le_bytes()[..register_size].to_vec())
+                })
+                .collect::<Result<Vec<_>>>()?
+                .concat()
+        };
+
+        Ok(StartInfo::builder()
+            .contents(contents)
+            .size(StartSize::MaxSize(count * register_size))
+            .registers(registers)
+            .build())
+    }
+
     /// Returns the address and whether the address is virtual for the testcase buffer used by
     /// the manual start functionality
     fn get_manual_start_info(&mut self, info: &ManualStartInfo) -> Result<StartInfo> {
@@ -472,8 +560,39 @@ pub trait ArchitectureOperations {
 
         testcase.truncate(info.size.maximum_size());
 
+        if !info.registers.is_empty() {
+            let register_size = if let Some(width) = Self::POINTER_WIDTH_OVERRIDE {
+                width as usize
+            } else {
+                addr_size
+            };
+
+            // Registers past the end of a short testcase are zeroed so no value from a
+            // previous testcase is left behind
+            testcase.resize(info.size.maximum_size(), 0);
+
+            return info
+                .registers
+                .iter()
+                .zip(testcase.chunks(register_size))
+                .try_for_each(|(register, chunk)| -> Result<()> {
+                    let mut value = [0u8; size_of::<u64>()];
+                    value[..chunk.len()].copy_from_slice(chunk);
+                    let number = self.int_register().get_number(register.as_raw_cstr()?)?;
+                    self.int_register()
+                        .write(number, u64::from_le_bytes(value))?;
+                    Ok(())
+                });
+        }
+
+        let address = info
+            .address
+            .as_ref()
+            .ok_or_else(|| anyhow!("No testcase buffer"))?
+            .physical_address();
+
         testcase.iter().enumerate().try_for_each(|(i, c)| {
-            let physical_address = info.address.physical_address() + (i as u64);
+            let physical_address = address + (i as u64);
             write_byte(physical_memory, physical_address, *c)
         })?;
 
@@ -493,8 +612,243 @@ pub trait ArchitectureOperations {
         Ok(())
     }
 
-    fn trace_pc(&mut self, instruction_query: *mut instruction_handle_t) -> Result<TraceEntry>;
-    fn trace_cmp(&mut self, instruction_query: *mut instruction_handle_t) -> Result<TraceEntry>;
+    /// Mask maskable interrupts on the processor by clearing its interrupt enable bits.
+    /// Returns the previous value of the interrupt enable register.
+    fn mask_interrupts(&mut self) -> Result<u64> {
+        let number = self
+            .int_register()
+            .get_number(Self::INTERRUPT_ENABLE_REGISTER.as_raw_cstr()?)?;
+        let value = self.int_register().read(number)?;
+        self.int_register()
+            .write(number, value & !Self::INTERRUPT_ENABLE_MASK)?;
+        Ok(value)
+    }
+
+    /// Restore the interrupt enable bits of the processor from a value previously returned
+    /// by `mask_interrupts`, leaving the other bits of the register unchanged
+    fn restore_interrupts(&mut self, value: u64) -> Result<()> {
+        let number = self
+            .int_register()
+            .get_number(Self::INTERRUPT_ENABLE_REGISTER.as_raw_cstr()?)?;
+        let current = self.int_register().read(number)?;
+        self.int_register().write(
+            number,
+            (current & !Self::INTERRUPT_ENABLE_MASK) | (value & Self::INTERRUPT_ENABLE_MASK),
+        )?;
+        Ok(())
+    }
+
+    /// The register number of the processor's address space register, which can be read
+    /// with `int_register` to identify the current address space
+    fn address_space_register_number(&mut self) -> Result<i32> {
+        Ok(self
+            .int_register()
+            .get_number(Self::ADDRESS_SPACE_REGISTER.as_raw_cstr()?)?)
+    }
+
+    /// Read the page table root of the processor's current address space from its address
+    /// space register, numbered `register`
+    fn address_space(&mut self, register: i32) -> Result<u64> {
+        Ok(self.int_register().read(register)? & Self::ADDRESS_SPACE_MASK)
+    }
+
+    /// Read the value of every integer register of the processor which can be read, in
+    /// register number order
+    fn register_values(&mut self) -> Result<Vec<u64>> {
+        let registers: Vec<u32> = self.int_register().all_registers()?.try_into()?;
+
+        Ok(registers
+            .into_iter()
+            .filter_map(|r| self.int_register().read(r as i32).ok())
+            .collect())
+    }
+
+    /// Get the guard region declared by the harness which takes the arguments:
+    ///
+    /// - address: The logical address of the region
+    /// - size: The size of the region in bytes
+    ///
+    /// The region is returned as the physical ranges backing it, split at page boundaries
+    /// because consecutive logical pages need not be physically contiguous
+    fn get_magic_guard(&mut self) -> Result<Vec<(u64, u64)>> {
+        let address_register_number = self
+            .int_register()
+            .get_number(Self::ARGUMENT_REGISTER_0.as_raw_cstr()?)?;
+        let size_register_number = self
+            .int_register()
+            .get_number(Self::ARGUMENT_REGISTER_1.as_raw_cstr()?)?;
+        let logical_address = self.int_register().read(address_register_number)?;
+        let size = self.int_register().read(size_register_number)?;
+
+        let mut ranges = Vec::new();
+        let mut offset = 0;
+
+        while offset < size {
+            let address = logical_address + offset;
+            let length = (GUARD_PAGE_SIZE - address % GUARD_PAGE_SIZE).min(size - offset);
+            let physical_address_block = self
+                .processor_info_v2()
+                .logical_to_physical(address, Access::Sim_Access_Read)?;
+
+            ensure!(
+                physical_address_block.valid != 0,
+                "Invalid linear address found in magic guard address register {address_register_number}: {address:#x}"
+            );
+
+            ranges.push((physical_address_block.address, length));
+            offset += length;
+        }
+
+        Ok(ranges)
+    }
+
+    /// Read the name and value of every integer register of the processor which can be read
+    fn named_register_values(&mut self) -> Result<BTreeMap<String, u64>> {
+        let registers: Vec<u32> = self.int_register().all_registers()?.try_into()?;
+
+        Ok(registers
+            .into_iter()
+            .filter_map(|r| {
+                let name = self.int_register().get_name(r as i32).ok()?;
+                let name = unsafe { CStr::from_ptr(name) }.to_str().ok()?.to_string();
+                let value = self.int_register().read(r as i32).ok()?;
+                Some((name, value))
+            })
+            .collect())
+    }
+
+    /// Read a pointer from the logical address `address`, returning `None` if the address is
+    /// not mapped
+    fn read_logical_pointer(&mut self, address: u64) -> Result<Option<u64>> {
+        let physical_address_block = self
+            .processor_info_v2()
+            .logical_to_physical(address, Access::Sim_Access_Read)?;
+
+        if physical_address_block.valid == 0 {
+            return Ok(None);
+        }
+
+        let pointer_size = if let Some(width) = Self::POINTER_WIDTH_OVERRIDE {
+            width
+        } else {
+            self.processor_info_v2().get_logical_address_width()? / u8::BITS as i32
+        };
+
+        Ok(Some(read_phys_memory(
+            self.cpu(),
+            physical_address_block.address,
+            pointer_size,
+        )?))
+    }
+
+    /// Walk the call stack by following the chain of saved frame pointers, returning the
+    /// program counter followed by up to `max_depth` return addresses. The walk stops early
+    /// at a null or unmapped frame, or a frame which does not move toward the stack base.
+    /// Targets compiled without frame pointers yield a partial or meaningless walk.
+    fn call_stack(&mut self, max_depth: usize) -> Result<Vec<u64>> {
+        let pointer_size = if let Some(width) = Self::POINTER_WIDTH_OVERRIDE {
+            width
+        } else {
+            self.processor_info_v2().get_logical_address_width()? / u8::BITS as i32
+        } as i64;
+
+        let mut stack = vec![self.processor_info_v2().get_program_counter()?];
+
+        let frame_pointer_number = self
+            .int_register()
+            .get_number(Self::FRAME_POINTER_REGISTER.as_raw_cstr()?)?;
+        let mut frame_pointer = self.int_register().read(frame_pointer_number)?;
+
+        while frame_pointer != 0 && stack.len() <= max_depth {
+            let slot = |slot: i64| frame_pointer.wrapping_add_signed(slot * pointer_size);
+
+            let Some(return_address) =
+                self.read_logical_pointer(slot(Self::RETURN_ADDRESS_SLOT))?
+            else {
+                break;
+            };
+            let Some(next_frame_pointer) =
+                self.read_logical_pointer(slot(Self::FRAME_POINTER_SLOT))?
+            else {
+                break;
+            };
+
+            if return_address == 0 {
+                break;
+            }
+
+            stack.push(return_address);
+
+            if next_frame_pointer <= frame_pointer {
+                break;
+            }
+
+            frame_pointer = next_frame_pointer;
+        }
+
+        Ok(stack)
+    }
+
+    /// The register the faulting address of `exception` is written to, if the exception is a
+    /// memory access fault
+    fn fault_address_register(&mut self, exception: i64) -> Result<Option<&'static str>> {
+        Ok(Self::FAULT_EXCEPTIONS
+            .contains(&exception)
+            .then_some(Self::FAULT_ADDRESS_REGISTER))
+    }
+
+    /// Read the address which caused the memory access fault `exception`, if it is a memory
+    /// access fault and the processor has its fault address register
+    fn fault_address(&mut self, exception: i64) -> Result<Option<u64>> {
+        let Some(register) = self.fault_address_register(exception)? else {
+            return Ok(None);
+        };
+
+        let Ok(number) = self.int_register().get_number(register.as_raw_cstr()?) else {
+            return Ok(None);
+        };
+
+        Ok(self.int_register().read(number).ok())
+    }
+
+    /// Whether the instruction is a call, return, or other control flow instruction, without
+    /// reading the program counter. Direct unconditional control flow instructions are only
+    /// included if `trace_direct_branches` is set.
+    fn is_control_flow(
+        &mut self,
+        instruction_query: *mut instruction_handle_t,
+        trace_direct_branches: bool,
+    ) -> Result<bool> {
+        let instruction_bytes = self
+            .cpu_instruction_query()
+            .get_instruction_bytes(instruction_query)?;
+        self.disassembler().disassemble(unsafe {
+            from_raw_parts(instruction_bytes.data, instruction_bytes.size)
+        })?;
+
+        Ok((self.disassembler().last_was_call()
+            || self.disassembler().last_was_control_flow()
+            || self.disassembler().last_was_ret())
+            && (trace_direct_branches || !self.disassembler().last_was_direct_unconditional()))
+    }
+
+    /// Trace the instruction, returning the program counter after it as an edge if it is a
+    /// control flow instruction. Direct unconditional control flow instructions, whose target
+    /// is determined by the instruction alone, are only traced if `trace_direct_branches` is
+    /// set.
+    fn trace_pc(
+        &mut self,
+        instruction_query: *mut instruction_handle_t,
+        trace_direct_branches: bool,
+    ) -> Result<TraceEntry>;
+    /// Trace the instruction, returning its program counter, type and operand values if it
+    /// is a comparison. Comparisons at a program counter in `skip_sites` return no entry
+    /// before their operands are evaluated.
+    fn trace_cmp(
+        &mut self,
+        instruction_query: *mut instruction_handle_t,
+        skip_sites: &HashSet<u64>,
+    ) -> Result<TraceEntry>;
 }
 
 impl ArchitectureOperations for Architecture {
@@ -502,6 +856,16 @@ impl ArchitectureOperations for Architecture {
     const ARGUMENT_REGISTER_0: &'static str = "";
     const ARGUMENT_REGISTER_1: &'static str = "";
     const ARGUMENT_REGISTER_2: &'static str = "";
+    const INTERRUPT_ENABLE_REGISTER: &'static str = "";
+    const INTERRUPT_ENABLE_MASK: u64 = 0;
+    const ADDRESS_SPACE_REGISTER: &'static str = "";
+    const ADDRESS_SPACE_MASK: u64 = 0;
+    const INPUT_REGISTERS: &'static [&'static str] = &[];
+    const FRAME_POINTER_REGISTER: &'static str = "";
+    const FRAME_POINTER_SLOT: i64 = 0;
+    const RETURN_ADDRESS_SLOT: i64 = 0;
+    const FAULT_ADDRESS_REGISTER: &'static str = "";
+    const FAULT_EXCEPTIONS: &'static [i64] = &[];
 
     fn new(cpu: *mut ConfObject) -> Result<Self>
     where
@@ -606,6 +970,22 @@ impl ArchitectureOperations for Architecture {
         }
     }
 
+    fn get_magic_start_registers(&mut self) -> Result<StartInfo> {
+        match self {
+            Architecture::X86_64(x86_64) => x86_64.get_magic_start_registers(),
+            Architecture::I386(i386) => i386.get_magic_start_registers(),
+            Architecture::Riscv(riscv) => riscv.get_magic_start_registers(),
+        }
+    }
+
+    fn get_magic_guard(&mut self) -> Result<Vec<(u64, u64)>> {
+        match self {
+            Architecture::X86_64(x86_64) => x86_64.get_magic_guard(),
+            Architecture::I386(i386) => i386.get_magic_guard(),
+            Architecture::Riscv(riscv) => riscv.get_magic_guard(),
+        }
+    }
+
     fn get_manual_start_info(&mut self, info: &ManualStartInfo) -> Result<StartInfo> {
         match self {
             Architecture::X86_64(x86_64) => x86_64.get_manual_start_info(info),
@@ -622,19 +1002,111 @@ impl ArchitectureOperations for Architecture {
         }
     }
 
-    fn trace_pc(&mut self, instruction_query: *mut instruction_handle_t) -> Result<TraceEntry> {
+    fn mask_interrupts(&mut self) -> Result<u64> {
+        match self {
+            Architecture::X86_64(x86_64) => x86_64.mask_interrupts(),
+            Architecture::I386(i386) => i386.mask_interrupts(),
+            Architecture::Riscv(riscv) => riscv.mask_interrupts(),
+        }
+    }
+
+    fn restore_interrupts(&mut self, value: u64) -> Result<()> {
+        match self {
+            Architecture::X86_64(x86_64) => x86_64.restore_interrupts(value),
+            Architecture::I386(i386) => i386.restore_interrupts(value),
+            Architecture::Riscv(riscv) => riscv.restore_interrupts(value),
+        }
+    }
+
+    fn address_space_register_number(&mut self) -> Result<i32> {
+        match self {
+            Architecture::X86_64(x86_64) => x86_64.address_space_register_number(),
+            Architecture::I386(i386) => i386.address_space_register_number(),
+            Architecture::Riscv(riscv) => riscv.address_space_register_number(),
+        }
+    }
+
+    fn address_space(&mut self, register: i32) -> Result<u64> {
+        match self {
+            Architecture::X86_64(x86_64) => x86_64.address_space(register),
+            Architecture::I386(i386) => i386.address_space(register),
+            Architecture::Riscv(riscv) => riscv.address_space(register),
+        }
+    }
+
+    fn read_logical_pointer(&mut self, address: u64) -> Result<Option<u64>> {
+        match self {
+            Architecture::X86_64(x86_64) => x86_64.read_logical_pointer(address),
+            Architecture::I386(i386) => i386.read_logical_pointer(address),
+            Architecture::Riscv(riscv) => riscv.read_logical_pointer(address),
+        }
+    }
+
+    fn call_stack(&mut self, max_depth: usize) -> Result<Vec<u64>> {
+        match self {
+            Architecture::X86_64(x86_64) => x86_64.call_stack(max_depth),
+            Architecture::I386(i386) => i386.call_stack(max_depth),
+            Architecture::Riscv(riscv) => riscv.call_stack(max_depth),
+        }
+    }
+
+    fn fault_address_register(&mut self, exception: i64) -> Result<Option<&'static str>> {
+        match self {
+            Architecture::X86_64(x86_64) => x86_64.fault_address_register(exception),
+            Architecture::I386(i386) => i386.fault_address_register(exception),
+            Architecture::Riscv(riscv) => riscv.fault_address_register(exception),
+        }
+    }
+
+    fn fault_address(&mut self, exception: i64) -> Result<Option<u64>> {
         match self {
-            Architecture::X86_64(x86_64) => x86_64.trace_pc(instruction_query),
-            Architecture::I386(i386) => i386.trace_pc(instruction_query),
-            Architecture::Riscv(riscv) => riscv.trace_pc(instruction_query),
+            Architecture::X86_64(x86_64) => x86_64.fault_address(exception),
+            Architecture::I386(i386) => i386.fault_address(exception),
+            Architecture::Riscv(riscv) => riscv.fault_address(exception),
+        }
+    }
+
+    fn is_control_flow(
+        &mut self,
+        instruction_query: *mut instruction_handle_t,
+        trace_direct_branches: bool,
+    ) -> Result<bool> {
+        match self {
+            Architecture::X86_64(x86_64) => {
+                x86_64.is_control_flow(instruction_query, trace_direct_branches)
+            }
+            Architecture::I386(i386) => {
+                i386.is_control_flow(instruction_query, trace_direct_branches)
+            }
+            Architecture::Riscv(riscv) => {
+                riscv.is_control_flow(instruction_query, trace_direct_branches)
+            }
+        }
+    }
+
+    fn trace_pc(
+        &mut self,
+        instruction_query: *mut instruction_handle_t,
+        trace_direct_branches: bool,
+    ) -> Result<TraceEntry> {
+        match self {
+            Architecture::X86_64(x86_64) => {
+                x86_64.trace_pc(instruction_query, trace_direct_branches)
+            }
+            Architecture::I386(i386) => i386.trace_pc(instruction_query, trace_direct_branches),
+            Architecture::Riscv(riscv) => riscv.trace_pc(instruction_query, trace_direct_branches),
         }
     }
 
-    fn trace_cmp(&mut self, instruction_query: *mut instruction_handle_t) -> Result<TraceEntry> {
+    fn trace_cmp(
+        &mut self,
+        instruction_query: *mut instruction_handle_t,
+        skip_sites: &HashSet<u64>,
+    ) -> Result<TraceEntry> {
         match self {
-            Architecture::X86_64(x86_64) => x86_64.trace_cmp(instruction_query),
-            Architecture::I386(i386) => i386.trace_cmp(instruction_query),
-            Architecture::Riscv(riscv) => riscv.trace_cmp(instruction_query),
+            Architecture::X86_64(x86_64) => x86_64.trace_cmp(instruction_query, skip_sites),
+            Architecture::I386(i386) => i386.trace_cmp(instruction_query, skip_sites),
+            Architecture::Riscv(riscv) => riscv.trace_cmp(instruction_query, skip_sites),
         }
     }
 }
@@ -11,7 +11,7 @@ use simics::api::{
     CpuInstructionQueryInterface, CpuInstrumentationSubscribeInterface, CycleInterface,
     IntRegisterInterface, ProcessorInfoV2Interface,
 };
-use std::{ffi::CStr, mem::size_of, slice::from_raw_parts};
+use std::{collections::HashSet, ffi::CStr, mem::size_of, slice::from_raw_parts};
 use yaxpeax_arch::{Decoder, U8Reader};
 use yaxpeax_riscv::{Instruction, Opcode, Operand, RiscVDecoder};
 
@@ -41,6 +41,39 @@ impl ArchitectureOperations for RISCVArchitectureOperations {
 
     const ARGUMENT_REGISTER_2: &'static str = "x13";
 
+    /// The machine and supervisor software, timer, and external interrupt enables in mie.
+    /// mstatus.MIE and mstatus.SIE do not mask interrupts taken while the hart runs below the
+    /// corresponding privilege level, so they cannot quiesce user mode targets. sie is a view
+    /// of the supervisor bits of mie, so clearing mie masks both levels.
+    const INTERRUPT_ENABLE_REGISTER: &'static str = "mie";
+
+    const INTERRUPT_ENABLE_MASK: u64 =
+        (1 << 1) | (1 << 3) | (1 << 5) | (1 << 7) | (1 << 9) | (1 << 11);
+
+    const ADDRESS_SPACE_REGISTER: &'static str = "satp";
+
+    /// The RV64 satp PPN in bits 43:0, without the ASID in bits 59:44 and the mode in bits
+    /// 63:60
+    const ADDRESS_SPACE_MASK: u64 = 0x0000_0fff_ffff_ffff;
+
+    /// a4 through a7
+    const INPUT_REGISTERS: &'static [&'static str] = &["x14", "x15", "x16", "x17"];
+
+    /// s0/fp, which points just above the saved return address and frame pointer
+    const FRAME_POINTER_REGISTER: &'static str = "x8";
+
+    const FRAME_POINTER_SLOT: i64 = -2;
+
+    const RETURN_ADDRESS_SLOT: i64 = -1;
+
+    /// The machine trap value register, which holds the faulting address of access faults
+    /// taken in machine mode. Faults delegated to supervisor mode use stval instead.
+    const FAULT_ADDRESS_REGISTER: &'static str = "mtval";
+
+    /// The address misaligned, access fault, and page fault exceptions of instruction fetches,
+    /// loads, and stores
+    const FAULT_EXCEPTIONS: &'static [i64] = &[0, 1, 4, 5, 6, 7, 12, 13, 15];
+
     fn new(cpu: *mut ConfObject) -> Result<Self> {
         let mut processor_info_v2: ProcessorInfoV2Interface = get_interface(cpu)?;
 
@@ -106,7 +139,11 @@ impl ArchitectureOperations for RISCVArchitectureOperations {
         &mut self.cycle
     }
 
-    fn trace_pc(&mut self, instruction_query: *mut instruction_handle_t) -> Result<TraceEntry> {
+    fn trace_pc(
+        &mut self,
+        instruction_query: *mut instruction_handle_t,
+        trace_direct_branches: bool,
+    ) -> Result<TraceEntry> {
         let instruction_bytes = self
             .cpu_instruction_query
             .get_instruction_bytes(instruction_query)?;
@@ -115,9 +152,10 @@ impl ArchitectureOperations for RISCVArchitectureOperations {
             from_raw_parts(instruction_bytes.data, instruction_bytes.size)
         })?;
 
-        if self.disassembler.last_was_call()
+        if (self.disassembler.last_was_call()
             || self.disassembler.last_was_control_flow()
-            || self.disassembler.last_was_ret()
+            || self.disassembler.last_was_ret())
+            && (trace_direct_branches || !self.disassembler.last_was_direct_unconditional())
         {
             Ok(TraceEntry::builder()
                 .edge(self.processor_info_v2.get_program_counter()?)
@@ -127,7 +165,11 @@ impl ArchitectureOperations for RISCVArchitectureOperations {
         }
     }
 
-    fn trace_cmp(&mut self, instruction_query: *mut instruction_handle_t) -> Result<TraceEntry> {
+    fn trace_cmp(
+        &mut self,
+        instruction_query: *mut instruction_handle_t,
+        skip_sites: &HashSet<u64>,
+    ) -> Result<TraceEntry> {
         let instruction_bytes = self
             .cpu_instruction_query
             .get_instruction_bytes(instruction_query)?;
@@ -137,6 +179,10 @@ impl ArchitectureOperations for RISCVArchitectureOperations {
 
         let pc = self.processor_info_v2.get_program_counter()?;
 
+        if skip_sites.contains(&pc) {
+            return Ok(TraceEntry::default());
+        }
+
         let mut cmp_values = Vec::new();
 
         for expr in self.disassembler.cmp() {
@@ -182,9 +228,45 @@ impl ArchitectureOperations for RISCVArchitectureOperations {
             ))
             .build())
     }
+
+    fn fault_address_register(&mut self, exception: i64) -> Result<Option<&'static str>> {
+        if !Self::FAULT_EXCEPTIONS.contains(&exception) {
+            return Ok(None);
+        }
+
+        // Faults delegated in medeleg are taken in supervisor mode, which writes stval. This
+        // is the case for faults of user mode targets under an operating system.
+        let delegated = self
+            .int_register()
+            .get_number("medeleg".as_raw_cstr()?)
+            .and_then(|n| self.int_register().read(n))
+            .is_ok_and(|medeleg| medeleg & (1 << exception) != 0);
+
+        Ok(Some(if delegated {
+            Self::SUPERVISOR_FAULT_ADDRESS_REGISTER
+        } else {
+            Self::FAULT_ADDRESS_REGISTER
+        }))
+    }
+
+    fn address_space(&mut self, register: i32) -> Result<u64> {
+        let satp = self.int_register().read(register)?;
+
+        if self.processor_info_v2.get_logical_address_width()? as u32 / u8::BITS == 8 {
+            Ok(satp & Self::ADDRESS_SPACE_MASK)
+        } else {
+            Ok(satp & Self::ADDRESS_SPACE_MASK_32)
+        }
+    }
 }
 
 impl RISCVArchitectureOperations {
+    /// The supervisor trap value register, which holds the faulting address of access faults
+    /// delegated to supervisor mode
+    const SUPERVISOR_FAULT_ADDRESS_REGISTER: &'static str = "stval";
+    /// The RV32 satp PPN in bits 21:0, without the ASID in bits 30:22 and the mode in bit 31
+    const ADDRESS_SPACE_MASK_32: u64 = 0x003f_ffff;
+
     fn simplify(&mut self, expr: &CmpExpr) -> Result<CmpValue> {
         match expr {
             CmpExpr::Deref((b, _)) => {
@@ -494,6 +576,21 @@ impl TracerDisassembler for Disassembler {
         false
     }
 
+    /// JAL jumps to a PC-relative target, and AUIPC (which is treated as a call above) always
+    /// continues at the next instruction
+    fn last_was_direct_unconditional(&self) -> bool {
+        if let Some(last) = self.last.as_ref() {
+            return matches!(last.opcode(), Opcode::JAL | Opcode::AUIPC);
+        }
+
+        false
+    }
+
+    fn last_was_conditional_branch(&self) -> bool {
+        // Only conditional branches are control flow, jumps are calls and returns
+        self.last_was_control_flow()
+    }
+
     fn last_was_cmp(&self) -> bool {
         if let Some(last) = self.last.as_ref() {
             return matches!(
@@ -3,7 +3,7 @@
 
 //! Architecture-specific implementation for x86-64 architecture
 
-use std::{ffi::CStr, mem::size_of, slice::from_raw_parts};
+use std::{collections::HashSet, ffi::CStr, mem::size_of, slice::from_raw_parts};
 
 use crate::{
     tracer::{CmpExpr, CmpType, CmpValue, TraceEntry},
@@ -17,7 +17,9 @@ use simics::api::{
     CpuInstructionQueryInterface, CpuInstrumentationSubscribeInterface, CycleInterface,
     IntRegisterInterface, ProcessorInfoV2Interface,
 };
-use yaxpeax_x86::amd64::{ConditionCode, InstDecoder, Instruction, Opcode, Operand};
+use yaxpeax_x86::amd64::{
+    register_class, ConditionCode, InstDecoder, Instruction, Opcode, Operand, RegSpec,
+};
 
 use super::ArchitectureOperations;
 
@@ -36,6 +38,20 @@ impl ArchitectureOperations for X86_64ArchitectureOperations {
     const ARGUMENT_REGISTER_0: &'static str = "rsi";
     const ARGUMENT_REGISTER_1: &'static str = "rdx";
     const ARGUMENT_REGISTER_2: &'static str = "rcx";
+    /// RFLAGS.IF
+    const INTERRUPT_ENABLE_REGISTER: &'static str = "rflags";
+    const INTERRUPT_ENABLE_MASK: u64 = 1 << 9;
+    const ADDRESS_SPACE_REGISTER: &'static str = "cr3";
+    /// The page table base in bits 51:12. Bits 11:0 hold the PCID (or PWT and PCD) and bits
+    /// 63:52 hold the LAM enables
+    const ADDRESS_SPACE_MASK: u64 = 0x000f_ffff_ffff_f000;
+    const INPUT_REGISTERS: &'static [&'static str] = &["r8", "r9", "r10", "r11"];
+    const FRAME_POINTER_REGISTER: &'static str = "rbp";
+    const FRAME_POINTER_SLOT: i64 = 0;
+    const RETURN_ADDRESS_SLOT: i64 = 1;
+    const FAULT_ADDRESS_REGISTER: &'static str = "cr2";
+    /// Page Fault (#PF), the only exception which writes cr2
+    const FAULT_EXCEPTIONS: &'static [i64] = &[14];
 
     fn new(cpu: *mut ConfObject) -> Result<Self> {
         let mut processor_info_v2: ProcessorInfoV2Interface = get_interface(cpu)?;
@@ -139,16 +155,21 @@ impl ArchitectureOperations for X86_64ArchitectureOperations {
         &mut self.cycle
     }
 
-    fn trace_pc(&mut self, instruction_query: *mut instruction_handle_t) -> Result<TraceEntry> {
+    fn trace_pc(
+        &mut self,
+        instruction_query: *mut instruction_handle_t,
+        trace_direct_branches: bool,
+    ) -> Result<TraceEntry> {
         let instruction_bytes = self
             .cpu_instruction_query
             .get_instruction_bytes(instruction_query)?;
         self.disassembler.disassemble(unsafe {
             from_raw_parts(instruction_bytes.data, instruction_bytes.size)
         })?;
-        if self.disassembler.last_was_call()
+        if (self.disassembler.last_was_call()
             || self.disassembler.last_was_control_flow()
-            || self.disassembler.last_was_ret()
+            || self.disassembler.last_was_ret())
+            && (trace_direct_branches || !self.disassembler.last_was_direct_unconditional())
         {
             Ok(TraceEntry::builder()
                 .edge(self.processor_info_v2.get_program_counter()?)
@@ -158,15 +179,25 @@ impl ArchitectureOperations for X86_64ArchitectureOperations {
         }
     }
 
-    fn trace_cmp(&mut self, instruction_query: *mut instruction_handle_t) -> Result<TraceEntry> {
+    fn trace_cmp(
+        &mut self,
+        instruction_query: *mut instruction_handle_t,
+        skip_sites: &HashSet<u64>,
+    ) -> Result<TraceEntry> {
         let instruction_bytes = self
             .cpu_instruction_query
             .get_instruction_bytes(instruction_query)?;
         self.disassembler.disassemble(unsafe {
             from_raw_parts(instruction_bytes.data, instruction_bytes.size)
         })?;
+        self.disassembler.track_transform();
         if self.disassembler.last_was_cmp() {
             let pc = self.processor_info_v2.get_program_counter()?;
+
+            if skip_sites.contains(&pc) {
+                return Ok(TraceEntry::default());
+            }
+
             let mut cmp_values = Vec::new();
 
             for expr in self.disassembler.cmp() {
@@ -708,9 +739,38 @@ impl X86_64ArchitectureOperations {
     }
 }
 
+/// Whether `a` and `b` are the same register or aliases of the same general purpose
+/// register, like `eax` and `al`
+fn registers_alias(a: RegSpec, b: RegSpec) -> bool {
+    let general_purpose_number = |register: RegSpec| {
+        let class = register.class();
+
+        if class == register_class::Q
+            || class == register_class::D
+            || class == register_class::W
+            || class == register_class::RB
+        {
+            Some(register.num())
+        } else if class == register_class::B {
+            // ah, ch, dh, and bh are the high bytes of the first four registers
+            Some(register.num() & 0b11)
+        } else {
+            None
+        }
+    };
+
+    match (general_purpose_number(a), general_purpose_number(b)) {
+        (Some(a_number), Some(b_number)) => a_number == b_number,
+        _ => a == b,
+    }
+}
+
 pub(crate) struct Disassembler {
     decoder: InstDecoder,
     last: Option<Instruction>,
+    /// The destination register of the most recent instruction traced for compares which
+    /// transformed its value, and the kind of transform
+    last_transform: Option<(RegSpec, CmpType)>,
 }
 
 impl Disassembler {
@@ -718,8 +778,100 @@ impl Disassembler {
         Self {
             decoder: InstDecoder::default(),
             last: None,
+            last_transform: None,
+        }
+    }
+
+    /// Record the destination register of the last instruction if the instruction applies a
+    /// transform to it which input-to-state solving can reverse, so a later compare of the
+    /// register can be annotated with the transform. Forget the recorded register if the last
+    /// instruction overwrites it some other way.
+    pub fn track_transform(&mut self) {
+        let Some(last) = self.last else {
+            return;
+        };
+
+        if last.operand_count() == 0 || self.last_was_cmp() {
+            return;
+        }
+
+        let Operand::Register(destination) = last.operand(0) else {
+            return;
+        };
+
+        let kind = match last.opcode() {
+            Opcode::ADD
+            | Opcode::ADC
+            | Opcode::SUB
+            | Opcode::SBB
+            | Opcode::INC
+            | Opcode::DEC
+            | Opcode::NEG
+            | Opcode::IMUL => Some(CmpType::IntMod),
+            Opcode::XOR
+            | Opcode::NOT
+            | Opcode::BSWAP
+            | Opcode::MOVBE
+            | Opcode::ROL
+            | Opcode::ROR
+            | Opcode::SHL
+            | Opcode::SHR
+            | Opcode::SAR => Some(CmpType::Transform),
+            _ => None,
+        };
+
+        if let Some(kind) = kind {
+            self.last_transform = Some((destination, kind));
+        } else if matches!(self.last_transform, Some((r, _)) if registers_alias(r, destination)) {
+            self.last_transform = None;
         }
     }
+
+    /// The comparison types implied by the condition of the last instruction
+    fn condition_cmp_type(&self) -> Vec<CmpType> {
+        if self.last_was_cmp() {
+            if let Some(last) = self.last {
+                if let Some(condition) = last.opcode().condition() {
+                    return match condition {
+                        // Overflow
+                        ConditionCode::O => vec![],
+                        // No Overflow
+                        ConditionCode::NO => vec![],
+                        // Below
+                        ConditionCode::B => vec![CmpType::Lesser],
+                        // Above or Equal
+                        ConditionCode::AE => vec![CmpType::Greater, CmpType::Equal],
+                        // Zero
+                        ConditionCode::Z => vec![],
+                        // Not Zero
+                        ConditionCode::NZ => vec![],
+                        // Above
+                        ConditionCode::A => vec![CmpType::Greater],
+                        // Below or Equal
+                        ConditionCode::BE => vec![CmpType::Lesser, CmpType::Equal],
+                        // Signed
+                        ConditionCode::S => vec![],
+                        // Not Signed
+                        ConditionCode::NS => vec![],
+                        // Parity
+                        ConditionCode::P => vec![],
+                        // No Parity
+                        ConditionCode::NP => vec![],
+                        // Less
+                        ConditionCode::L => vec![CmpType::Lesser],
+                        // Greater or Equal
+                        ConditionCode::GE => vec![CmpType::Greater, CmpType::Equal],
+                        // Greater
+                        ConditionCode::G => vec![CmpType::Greater],
+                        // Less or Equal
+                        ConditionCode::LE => vec![CmpType::Lesser, CmpType::Equal],
+                    };
+                }
+            }
+        }
+
+        vec![]
+    }
 }
 
 impl Default for Disassembler {
@@ -824,6 +976,11 @@ impl TryFrom<(&Operand, Option<u8>)> for CmpExpr {
 }
 
 impl TracerDisassembler for Disassembler {
+    /// Forget the last transformed register, which does not carry over to the next iteration
+    fn reset(&mut self) {
+        self.last_transform = None;
+    }
+
     /// Check if an instruction is a control flow instruction
     fn last_was_control_flow(&self) -> bool {
         if let Some(last) = self.last {
@@ -892,6 +1049,23 @@ impl TracerDisassembler for Disassembler {
         false
     }
 
+    /// Check if an instruction is a near jump or call to a relative immediate target
+    fn last_was_direct_unconditional(&self) -> bool {
+        if let Some(last) = self.last {
+            return matches!(last.opcode(), Opcode::JMP | Opcode::CALL)
+                && matches!(
+                    last.operand(0),
+                    Operand::ImmediateI8(_) | Operand::ImmediateI16(_) | Operand::ImmediateI32(_)
+                );
+        }
+
+        false
+    }
+
+    fn last_was_conditional_branch(&self) -> bool {
+        self.last_was_control_flow() && self.last.is_some_and(|l| l.opcode() != Opcode::JMP)
+    }
+
     /// Check if an instruction is a cmp instruction
     fn last_was_cmp(&self) -> bool {
         if let Some(last) = self.last {
@@ -983,47 +1157,19 @@ impl TracerDisassembler for Disassembler {
     }
 
     fn cmp_type(&self) -> Vec<CmpType> {
-        if self.last_was_cmp() {
-            if let Some(last) = self.last {
-                if let Some(condition) = last.opcode().condition() {
-                    return match condition {
-                        // Overflow
-                        ConditionCode::O => vec![],
-                        // No Overflow
-                        ConditionCode::NO => vec![],
-                        // Below
-                        ConditionCode::B => vec![CmpType::Lesser],
-                        // Above or Equal
-                        ConditionCode::AE => vec![CmpType::Greater, CmpType::Equal],
-                        // Zero
-                        ConditionCode::Z => vec![],
-                        // Not Zero
-                        ConditionCode::NZ => vec![],
-                        // Above
-                        ConditionCode::A => vec![CmpType::Greater],
-                        // Below or Equal
-                        ConditionCode::BE => vec![CmpType::Lesser, CmpType::Equal],
-                        // Signed
-                        ConditionCode::S => vec![],
-                        // Not Signed
-                        ConditionCode::NS => vec![],
-                        // Parity
-                        ConditionCode::P => vec![],
-                        // No Parity
-                        ConditionCode::NP => vec![],
-                        // Less
-                        ConditionCode::L => vec![CmpType::Lesser],
-                        // Greater or Equal
-                        ConditionCode::GE => vec![CmpType::Greater, CmpType::Equal],
-                        // Greater
-                        ConditionCode::G => vec![CmpType::Greater],
-                        // Less or Equal
-                        ConditionCode::LE => vec![CmpType::Lesser, CmpType::Equal],
-                    };
-                }
+        let mut cmp_type = self.condition_cmp_type();
+
+        // Annotate compares of a register which was just transformed, so the redqueen stage
+        // also tries the transformed candidates
+        if let (Some(last), Some((register, kind))) = (self.last, self.last_transform) {
+            if self.last_was_cmp()
+                && (0..last.operand_count())
+                    .any(|i| matches!(last.operand(i), Operand::Register(r) if registers_alias(r, register)))
+            {
+                cmp_type.push(kind);
             }
         }
 
-        vec![]
+        cmp_type
     }
 }
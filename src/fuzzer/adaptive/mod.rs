@@ -0,0 +1,181 @@
+// Copyright (C) 2024 Intel Corporation
+// SPDX-License-Identifier: Apache-2.0
+
+//! Adaptive scheduling of the comparison logging stages, which are only run once cheaper
+//! mutations stop finding new coverage and are backed off again when they stop paying
+
+use libafl::{
+    stages::Stage,
+    state::{HasExecutions, State, UsesState},
+};
+use serde::Serialize;
+use std::{cell::Cell, rc::Rc};
+
+#[derive(Debug, Clone, Copy, Default, Serialize)]
+/// The executions run and corpus entries found while the comparison logging stages were
+/// either enabled or disabled
+pub(crate) struct ModeYield {
+    pub executions: u64,
+    pub corpus_entries_found: u64,
+}
+
+impl ModeYield {
+    fn add(&mut self, executions: u64, found: u64) {
+        self.executions += executions;
+        self.corpus_entries_found += found;
+    }
+
+    /// The number of corpus entries found per thousand executions
+    pub fn per_thousand_executions(&self) -> f64 {
+        if self.executions == 0 {
+            0.0
+        } else {
+            self.corpus_entries_found as f64 * 1000.0 / self.executions as f64
+        }
+    }
+}
+
+#[derive(Debug, Clone)]
+/// Decides whether the comparison logging stages run, once per window of executions. The
+/// stages are enabled when the rate of new corpus entries in a window without them drops
+/// below the threshold. They are disabled again when a window with them also stays below
+/// the threshold, and are not retried for a number of windows which doubles each time they
+/// fail to pay off.
+pub(crate) struct AdaptiveCmplog {
+    /// The rate of new corpus entries per thousand executions below which coverage is
+    /// considered stagnant
+    threshold: f64,
+    /// The number of executions in each window
+    window: u64,
+    /// Whether the comparison logging stages are currently enabled
+    enabled: bool,
+    /// The yield of the current window
+    window_yield: ModeYield,
+    /// The total yield while the comparison logging stages were disabled
+    pub without_cmplog: ModeYield,
+    /// The total yield while the comparison logging stages were enabled
+    pub with_cmplog: ModeYield,
+    /// The number of windows to wait before retrying the stages the next time they are
+    /// disabled
+    backoff_windows: u32,
+    /// The number of windows left to wait before the stages may be enabled again
+    windows_until_retry: u32,
+}
+
+impl AdaptiveCmplog {
+    /// The maximum number of windows to wait before retrying the comparison logging stages
+    const MAX_BACKOFF_WINDOWS: u32 = 64;
+
+    /// Create a new schedule, starting with the comparison logging stages disabled
+    pub fn new(threshold: f64, window: usize) -> Self {
+        Self {
+            threshold,
+            window: window.max(1) as u64,
+            enabled: false,
+            window_yield: ModeYield::default(),
+            without_cmplog: ModeYield::default(),
+            with_cmplog: ModeYield::default(),
+            backoff_windows: 1,
+            windows_until_retry: 0,
+        }
+    }
+
+    /// Whether the comparison logging stages are currently enabled
+    pub fn enabled(&self) -> bool {
+        self.enabled
+    }
+
+    /// Record the executions run, not counting those of analysis stages, and corpus entries
+    /// found by one iteration of the fuzzing loop. Returns whether the comparison logging
+    /// stages were enabled or disabled as a result.
+    pub fn record(&mut self, executions: u64, found: u64) -> bool {
+        self.window_yield.add(executions, found);
+
+        if self.enabled {
+            self.with_cmplog.add(executions, found);
+        } else {
+            self.without_cmplog.add(executions, found);
+        }
+
+        if self.window_yield.executions < self.window {
+            return false;
+        }
+
+        let stagnant = self.window_yield.per_thousand_executions() < self.threshold;
+        self.window_yield = ModeYield::default();
+
+        match (self.enabled, stagnant) {
+            (false, _) if self.windows_until_retry > 0 => {
+                self.windows_until_retry -= 1;
+                false
+            }
+            (false, true) => {
+                self.enabled = true;
+                true
+            }
+            (true, true) => {
+                self.enabled = false;
+                self.windows_until_retry = self.backoff_windows;
+                self.backoff_windows = (self.backoff_windows * 2).min(Self::MAX_BACKOFF_WINDOWS);
+                true
+            }
+            (true, false) => {
+                self.backoff_windows = 1;
+                false
+            }
+            (false, false) => false,
+        }
+    }
+}
+
+/// A stage whose executions analyze the current corpus entry instead of testing new inputs,
+/// such as colorization and comparison tracing. The executions it performs are counted so
+/// they can be left out of the yield of the comparison logging stages, which would otherwise
+/// be depressed by their own analysis executions.
+pub(crate) struct AnalysisStage<ST> {
+    stage: ST,
+    executions: Rc<Cell<u64>>,
+}
+
+impl<ST> AnalysisStage<ST> {
+    /// Wrap `stage`, adding the number of executions it performs to `executions`
+    pub fn new(stage: ST, executions: Rc<Cell<u64>>) -> Self {
+        Self { stage, executions }
+    }
+}
+
+impl<ST> UsesState for AnalysisStage<ST>
+where
+    ST: UsesState,
+    ST::State: State,
+{
+    type State = ST::State;
+}
+
+impl<E, EM, ST, Z> Stage<E, EM, Z> for AnalysisStage<ST>
+where
+    ST: Stage<E, EM, Z>,
+    ST::State: State + HasExecutions,
+    E: UsesState<State = ST::State>,
+    EM: UsesState<State = ST::State>,
+    Z: UsesState<State = ST::State>,
+{
+    type Progress = ST::Progress;
+
+    fn perform(
+        &mut self,
+        fuzzer: &mut Z,
+        executor: &mut E,
+        state: &mut Self::State,
+        manager: &mut EM,
+    ) -> Result<(), libafl::Error> {
+        let executions = *state.executions();
+
+        let result = self.stage.perform(fuzzer, executor, state, manager);
+
+        self.executions
+            .set(self.executions.get() + state.executions().saturating_sub(executions) as u64);
+
+        result
+    }
+}
@@ -0,0 +1,78 @@
+// Copyright (C) 2024 Intel Corporation
+// SPDX-License-Identifier: Apache-2.0
+
+//! Fuzzer profiles assigned to the instances of an ensemble, so that instances sharing a
+//! corpus explore it with diverse settings instead of all using the same ones
+
+use crate::tracer::CoverageMode;
+use libafl::schedulers::powersched::PowerSchedule;
+
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+/// The fuzzer settings used by one instance of an ensemble
+pub(crate) struct EnsembleProfile {
+    /// The name the profile is reported with
+    pub name: &'static str,
+    /// Whether comparison logging stages are run
+    pub cmplog: bool,
+    /// The power schedule used to choose corpus entries and how many times to mutate them
+    pub power_schedule: PowerSchedule,
+    /// How edge hits are recorded in the coverage map
+    pub coverage_mode: CoverageMode,
+    /// The maximum size of mutated testcases, if smaller than the testcase buffer
+    pub max_size: Option<usize>,
+}
+
+/// The profiles assigned to ensemble instances, in order. Instance `i` uses profile
+/// `i % ENSEMBLE_PROFILES.len()`, so the first instance uses the default settings and each
+/// additional instance adds a different strategy until all profiles are in use.
+pub(crate) const ENSEMBLE_PROFILES: &[EnsembleProfile] = &[
+    EnsembleProfile {
+        name: "default",
+        cmplog: true,
+        power_schedule: PowerSchedule::EXPLORE,
+        coverage_mode: CoverageMode::HitCount,
+        max_size: None,
+    },
+    EnsembleProfile {
+        name: "fast",
+        cmplog: false,
+        power_schedule: PowerSchedule::FAST,
+        coverage_mode: CoverageMode::HitCount,
+        max_size: None,
+    },
+    EnsembleProfile {
+        name: "exploit",
+        cmplog: true,
+        power_schedule: PowerSchedule::EXPLOIT,
+        coverage_mode: CoverageMode::HitCount,
+        max_size: None,
+    },
+    EnsembleProfile {
+        name: "once",
+        cmplog: false,
+        power_schedule: PowerSchedule::COE,
+        coverage_mode: CoverageMode::Once,
+        max_size: None,
+    },
+    EnsembleProfile {
+        name: "small",
+        cmplog: true,
+        power_schedule: PowerSchedule::FAST,
+        coverage_mode: CoverageMode::HitCount,
+        max_size: Some(256),
+    },
+    EnsembleProfile {
+        name: "small-once",
+        cmplog: false,
+        power_schedule: PowerSchedule::EXPLORE,
+        coverage_mode: CoverageMode::Once,
+        max_size: Some(256),
+    },
+];
+
+impl EnsembleProfile {
+    /// The profile used by ensemble instance `instance`
+    pub fn for_instance(instance: usize) -> Self {
+        ENSEMBLE_PROFILES[instance % ENSEMBLE_PROFILES.len()]
+    }
+}
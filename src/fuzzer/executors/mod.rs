@@ -0,0 +1,230 @@
+// Copyright (C) 2024 Intel Corporation
+// SPDX-License-Identifier: Apache-2.0
+
+//! Executor for the hand-off protocol between the fuzzer thread and the simulator
+//!
+//! Each execution only sends a testcase to the simulator and waits for its exit kind, and the
+//! real per-iteration timeout is enforced in virtual time by the simulator. The executor
+//! therefore arms no host timer per execution. Instead, every execution updates a shared
+//! heartbeat, and a single watchdog thread stops the fuzzer if the simulator does not respond
+//! to an execution within the executor timeout.
+
+use crate::log::timeline::Timeline;
+use anyhow::{anyhow, Result};
+use libafl::{
+    executors::{Executor, HasObservers},
+    observers::UsesObservers,
+    prelude::{ExitKind, ObserversTuple},
+    state::{HasExecutions, State, UsesState},
+};
+use std::{
+    fmt::Debug,
+    marker::PhantomData,
+    process::exit,
+    sync::{
+        atomic::{AtomicU64, Ordering},
+        Arc,
+    },
+    thread::{sleep, Builder, JoinHandle},
+    time::{Duration, Instant},
+};
+
+/// Heartbeat shared between the executors and the watchdog. Records the time the execution
+/// currently in flight started, if any.
+#[derive(Debug, Clone)]
+pub(crate) struct Heartbeat {
+    /// The reference point for execution start times
+    epoch: Instant,
+    /// Nanoseconds since `epoch` plus one at which the execution in flight started, or zero if
+    /// no execution is in flight
+    started: Arc<AtomicU64>,
+}
+
+impl Default for Heartbeat {
+    fn default() -> Self {
+        Self {
+            epoch: Instant::now(),
+            started: Arc::new(AtomicU64::new(0)),
+        }
+    }
+}
+
+impl Heartbeat {
+    /// Mark the start of an execution
+    fn begin(&self) {
+        let now = self.epoch.elapsed().as_nanos() as u64;
+        self.started.store(now.saturating_add(1), Ordering::Release);
+    }
+
+    /// Mark the end of an execution
+    fn end(&self) {
+        self.started.store(0, Ordering::Release);
+    }
+
+    /// How long the execution in flight has been running, if there is one
+    fn in_flight(&self) -> Option<Duration> {
+        match self.started.load(Ordering::Acquire) {
+            0 => None,
+            started => Some(
+                self.epoch
+                    .elapsed()
+                    .saturating_sub(Duration::from_nanos(started - 1)),
+            ),
+        }
+    }
+
+    /// Whether the watchdog holds the only remaining reference to the heartbeat
+    fn orphaned(&self) -> bool {
+        Arc::strong_count(&self.started) <= 1
+    }
+
+    /// Spawn the watchdog thread for this heartbeat. If an execution is in flight for longer
+    /// than `timeout`, the simulator is considered wedged and the process exits, as the
+    /// fuzzer can make no further progress. The `timeline`, if any, is finished before exiting
+    /// so its file is complete. The watchdog exits once all executors using the heartbeat are
+    /// dropped.
+    pub(crate) fn spawn_watchdog(
+        &self,
+        timeout: Duration,
+        timeline: Option<Timeline>,
+    ) -> Result<JoinHandle<()>> {
+        let heartbeat = self.clone();
+        // Poll several times per timeout period so a wedged execution is detected within a
+        // small fraction of the timeout
+        let interval = (timeout / 8).clamp(Duration::from_millis(100), Duration::from_secs(5));
+
+        Builder::new()
+            .name("tsffs-watchdog".to_string())
+            .spawn(move || loop {
+                sleep(interval);
+
+                if heartbeat.orphaned() {
+                    break;
+                }
+
+                if let Some(elapsed) = heartbeat.in_flight() {
+                    if elapsed > timeout {
+                        eprintln!(
+                            "Simulator did not complete an iteration within the executor \
+                            timeout ({}s elapsed, timeout {}s). Stopping.",
+                            elapsed.as_secs(),
+                            timeout.as_secs()
+                        );
+
+                        if let Some(timeline) = timeline.as_ref() {
+                            timeline.finish();
+                        }
+
+                        exit(1);
+                    }
+                }
+            })
+            .map_err(|e| anyhow!("Failed to spawn watchdog thread: {e}"))
+    }
+}
+
+/// Executor which hands each input to the simulator through the harness function and
+/// returns the exit kind the simulator reports, without a per-execution host timer
+pub(crate) struct SimicsExecutor<'a, H, OT, S>
+where
+    H: FnMut(&S::Input) -> ExitKind,
+    OT: ObserversTuple<S>,
+    S: State,
+{
+    /// The harness function which sends the input and waits for the exit kind
+    harness_fn: &'a mut H,
+    /// The observers of this executor
+    observers: OT,
+    /// The heartbeat updated around each execution
+    heartbeat: Heartbeat,
+    phantom: PhantomData<S>,
+}
+
+impl<'a, H, OT, S> SimicsExecutor<'a, H, OT, S>
+where
+    H: FnMut(&S::Input) -> ExitKind,
+    OT: ObserversTuple<S>,
+    S: State,
+{
+    /// Create a new executor running `harness_fn` and reporting to `heartbeat`
+    pub(crate) fn new(harness_fn: &'a mut H, observers: OT, heartbeat: Heartbeat) -> Self {
+        Self {
+            harness_fn,
+            observers,
+            heartbeat,
+            phantom: PhantomData,
+        }
+    }
+}
+
+impl<'a, H, OT, S> Debug for SimicsExecutor<'a, H, OT, S>
+where
+    H: FnMut(&S::Input) -> ExitKind,
+    OT: ObserversTuple<S>,
+    S: State,
+{
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        f.debug_struct("SimicsExecutor")
+            .field("observers", &self.observers)
+            .field("heartbeat", &self.heartbeat)
+            .finish_non_exhaustive()
+    }
+}
+
+impl<'a, H, OT, S> UsesState for SimicsExecutor<'a, H, OT, S>
+where
+    H: FnMut(&S::Input) -> ExitKind,
+    OT: ObserversTuple<S>,
+    S: State,
+{
+    type State = S;
+}
+
+impl<'a, H, OT, S> UsesObservers for SimicsExecutor<'a, H, OT, S>
+where
+    H: FnMut(&S::Input) -> ExitKind,
+    OT: ObserversTuple<S>,
+    S: State,
+{
+    type Observers = OT;
+}
+
+impl<'a, H, OT, S> HasObservers for SimicsExecutor<'a, H, OT, S>
+where
+    H: FnMut(&S::Input) -> ExitKind,
+    OT: ObserversTuple<S>,
+    S: State,
+{
+    fn observers(&self) -> &OT {
+        &self.observers
+    }
+
+    fn observers_mut(&mut self) -> &mut OT {
+        &mut self.observers
+    }
+}
+
+impl<'a, EM, H, OT, S, Z> Executor<EM, Z> for SimicsExecutor<'a, H, OT, S>
+where
+    EM: UsesState<State = S>,
+    H: FnMut(&S::Input) -> ExitKind,
+    OT: ObserversTuple<S>,
+    S: State + HasExecutions,
+    Z: UsesState<State = S>,
+{
+    fn run_target(
+        &mut self,
+        _fuzzer: &mut Z,
+        state: &mut S,
+        _mgr: &mut EM,
+        input: &S::Input,
+    ) -> Result<ExitKind, libafl::Error> {
+        *state.executions_mut() += 1;
+
+        self.heartbeat.begin();
+        let exit_kind = (self.harness_fn)(input);
+        self.heartbeat.end();
+
+        Ok(exit_kind)
+    }
+}
@@ -7,7 +7,7 @@ use libafl::{
     inputs::HasTargetBytes,
     observers::UsesObserver,
     prelude::{ExitKind, MapObserver, Observer, ObserversTuple, UsesInput},
-    state::{HasCorpus, HasNamedMetadata, State},
+    state::{HasCorpus, HasMetadata, HasNamedMetadata, State},
 };
 use libafl_bolts::{AsIter, AsSlice, Named};
 use serde::{de::DeserializeOwned, Deserialize, Serialize};
@@ -16,7 +16,7 @@ use std::{
     sync::{mpsc::Sender, OnceLock},
 };
 
-use super::messages::FuzzerMessage;
+use super::{messages::FuzzerMessage, observers::InputAccessObserver};
 
 #[derive(Clone, Debug)]
 pub(crate) struct ReportingMapFeedback<N, O, R, S, T> {
@@ -175,3 +175,69 @@ where
         Self { base, sender }
     }
 }
+
+#[derive(Clone, Debug)]
+/// Feedback which never marks a testcase as interesting, but attaches the testcase bytes the
+/// target read to each testcase added to the corpus
+pub(crate) struct InputAccessFeedback {
+    /// The name of the input access observer
+    observer_name: String,
+}
+
+impl InputAccessFeedback {
+    #[must_use]
+    pub fn new(observer: &InputAccessObserver) -> Self {
+        Self {
+            observer_name: observer.name().to_string(),
+        }
+    }
+}
+
+impl Named for InputAccessFeedback {
+    #[inline]
+    fn name(&self) -> &str {
+        &self.observer_name
+    }
+}
+
+impl<S> Feedback<S> for InputAccessFeedback
+where
+    S: State,
+{
+    fn is_interesting<EM, OT>(
+        &mut self,
+        _state: &mut S,
+        _manager: &mut EM,
+        _input: &<S>::Input,
+        _observers: &OT,
+        _exit_kind: &ExitKind,
+    ) -> Result<bool, libafl::Error>
+    where
+        EM: EventFirer<State = S>,
+        OT: ObserversTuple<S>,
+    {
+        Ok(false)
+    }
+
+    fn append_metadata<EM, OT>(
+        &mut self,
+        _state: &mut S,
+        _manager: &mut EM,
+        observers: &OT,
+        testcase: &mut libafl::prelude::Testcase<<S>::Input>,
+    ) -> Result<(), libafl::Error>
+    where
+        OT: ObserversTuple<S>,
+        EM: EventFirer<State = S>,
+    {
+        let observer = observers
+            .match_name::<InputAccessObserver>(&self.observer_name)
+            .ok_or_else(|| libafl::Error::unknown("Failed to get observer from observers tuple"))?;
+
+        if let Some(metadata) = observer.metadata() {
+            testcase.add_metadata(metadata);
+        }
+
+        Ok(())
+    }
+}
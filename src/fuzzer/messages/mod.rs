@@ -1,10 +1,24 @@
 // Copyright (C) 2024 Intel Corporation
 // SPDX-License-Identifier: Apache-2.0
 
+use crate::fuzzer::adaptive::ModeYield;
 use serde::Serialize;
 
 #[derive(Serialize, Debug, Clone)]
 pub(crate) enum FuzzerMessage {
     String(String),
-    Interesting { indices: Vec<usize>, input: Vec<u8> },
+    Interesting {
+        indices: Vec<usize>,
+        input: Vec<u8>,
+    },
+    /// The number of corpus entries found by this instance, not counting entries synchronized
+    /// from other instances, in one iteration of the fuzzing loop
+    CorpusEntriesFound(usize),
+    /// The comparison logging stages were enabled or disabled by the adaptive schedule, with
+    /// the yield of each mode so far
+    CmplogYield {
+        enabled: bool,
+        without_cmplog: ModeYield,
+        with_cmplog: ModeYield,
+    },
 }
@@ -4,7 +4,20 @@
 //! Fuzzing engine implementation, configure and run LibAFL on a separate thread
 
 use crate::{
-    fuzzer::{feedbacks::ReportingMapFeedback, messages::FuzzerMessage},
+    fuzzer::{
+        adaptive::{AdaptiveCmplog, AnalysisStage},
+        ensemble::EnsembleProfile,
+        executors::{Heartbeat, SimicsExecutor},
+        feedbacks::{InputAccessFeedback, ReportingMapFeedback},
+        messages::FuzzerMessage,
+        mutators::{
+            CustomMutator, CustomMutatorLibrary, CustomPostProcessors, IntegerTokenReplace,
+            IntegerTokens,
+        },
+        observers::InputAccessObserver,
+        remote::{run_remote_executor, RemoteChannel, RemoteMutationalStage},
+    },
+    log::timeline::{TimedStage, Timeline, TimelineThread},
     Tsffs,
 };
 use anyhow::{anyhow, Result};
@@ -14,9 +27,9 @@ use libafl::{
     prelude::{
         havoc_mutations, ondisk::OnDiskMetadataFormat, tokens_mutations, AFLppRedQueen, BytesInput,
         CachedOnDiskCorpus, Corpus, CrashFeedback, ExitKind, HasCurrentCorpusIdx, HasTargetBytes,
-        HitcountsMapObserver, I2SRandReplace, InProcessExecutor, MaxMapFeedback, OnDiskCorpus,
-        RandBytesGenerator, SimpleEventManager, SimpleMonitor, StdCmpValuesObserver,
-        StdMOptMutator, StdMapObserver, StdScheduledMutator, TimeFeedback, TimeObserver, Tokens,
+        I2SRandReplace, MaxMapFeedback, OnDiskCorpus, RandBytesGenerator, SimpleEventManager,
+        SimpleMonitor, StdCmpValuesObserver, StdMOptMutator, StdMapObserver, StdScheduledMutator,
+        TimeFeedback, TimeObserver, Tokens,
     },
     schedulers::{
         powersched::PowerSchedule, IndexesLenTimeMinimizerScheduler, StdWeightedScheduler,
@@ -26,7 +39,7 @@ use libafl::{
         GeneralizationStage, IfStage, StdMutationalStage, StdPowerMutationalStage,
         SyncFromDiskStage, TracingStage,
     },
-    state::{HasCorpus, HasMetadata, StdState},
+    state::{HasCorpus, HasExecutions, HasMaxSize, HasMetadata, StdState},
     Fuzzer, StdFuzzer,
 };
 use libafl_bolts::{
@@ -37,24 +50,42 @@ use libafl_bolts::{
     AsMutSlice, AsSlice,
 };
 use libafl_targets::{AFLppCmpLogObserver, AFLppCmplogTracingStage};
-use simics::{api::AsConfObject, debug, trace, warn};
+use serde_json::to_string;
+use simics::{api::AsConfObject, debug, info, trace, warn};
 use std::{
-    cell::RefCell, fmt::Debug, fs::write, io::stderr, slice::from_raw_parts_mut,
-    sync::mpsc::channel, thread::spawn, time::Duration,
+    cell::{Cell, RefCell},
+    collections::HashSet,
+    fmt::Debug,
+    fs::write,
+    io::stderr,
+    rc::Rc,
+    slice::from_raw_parts_mut,
+    sync::{mpsc::channel, Arc},
+    thread::spawn,
+    time::Duration,
 };
-use tokenize::{tokenize_executable_file, tokenize_src_file};
+use tokenize::{tokenize_executable_file, tokenize_src_file, tokenize_src_file_integers};
 use tracing::{level_filters::LevelFilter, Level};
 use tracing_subscriber::{
     filter::filter_fn, fmt, layer::SubscriberExt, registry, util::SubscriberInitExt, Layer,
 };
 
+pub mod adaptive;
+pub mod ensemble;
+pub mod executors;
 pub mod feedbacks;
 pub mod messages;
+pub mod mutators;
+pub mod observers;
+pub mod remote;
 pub mod tokenize;
 
 #[derive(Clone, PartialEq, Eq)]
 pub(crate) struct Testcase {
     pub testcase: BytesInput,
+    /// The name the corpora give the input this testcase was made from. Post-processors may
+    /// change the testcase, so this is generated from the input before post-processing.
+    pub name: String,
     pub cmplog: bool,
 }
 
@@ -78,6 +109,7 @@ impl Debug for Testcase {
                     self.testcase.bytes().len()
                 ),
             )
+            .field("name", &self.name)
             .field("cmplog", &self.cmplog)
             .finish()
     }
@@ -91,6 +123,7 @@ impl Tsffs {
     const AFLPP_CMP_OBSERVER_NAME: &'static str = "aflpp_cmplog";
     const CMPLOG_OBSERVER_NAME: &'static str = "cmplog";
     const TIME_OBSERVER_NAME: &'static str = "time";
+    const INPUT_ACCESS_OBSERVER_NAME: &'static str = "input_access";
     const TIMEOUT_FEEDBACK_NAME: &'static str = "time";
     const CORPUS_CACHE_SIZE: usize = 4096;
 
@@ -104,6 +137,19 @@ impl Tsffs {
 
         debug!(self.as_conf_object_mut(), "Starting fuzzer thread");
 
+        if let Ok(instance) = usize::try_from(self.ensemble_instance) {
+            let profile = EnsembleProfile::for_instance(instance);
+
+            info!(
+                self.as_conf_object(),
+                "Using ensemble profile '{}' for instance {instance}", profile.name
+            );
+
+            self.cmplog = profile.cmplog;
+            self.coverage_mode = profile.coverage_mode;
+            self.ensemble_profile = Some(profile);
+        }
+
         let (tx, orx) = channel::<ExitKind>();
         let (otx, rx) = channel::<Testcase>();
         let (stx, srx) = channel::<ShutdownMessage>();
@@ -135,6 +181,23 @@ impl Tsffs {
             )
         };
 
+        if !self.remote_fuzzer_channel.is_empty() {
+            // This instance only executes inputs for a central fuzzer, so it starts no fuzzer
+            let channel = self.remote_fuzzer_channel.clone();
+            let (otx, orx) = client.into_inner();
+
+            self.fuzz_thread
+                .set(spawn(move || -> Result<()> {
+                    run_remote_executor(&channel, coverage_map, otx, orx, srx).map_err(|e| {
+                        eprintln!("Error running remote executor: {e}");
+                        e
+                    })
+                }))
+                .map_err(|_| anyhow!("Fuzzer thread already set"))?;
+
+            return Ok(());
+        }
+
         let aflpp_cmp_map = Box::leak(unsafe {
             Box::from_raw(
                 *self
@@ -153,7 +216,25 @@ impl Tsffs {
             )
         });
 
+        if self.export_timeline && self.timeline.is_none() {
+            self.timeline = Some(Timeline::start(
+                &self.timeline_path,
+                Duration::from_secs_f64(self.timeline_duration.max(0.0)),
+            )?);
+        }
+
+        let timeline = self.timeline.clone();
         let cmplog_enabled = self.cmplog;
+        let mut adaptive_cmplog = (cmplog_enabled && self.cmplog_adaptive).then(|| {
+            AdaptiveCmplog::new(self.cmplog_adaptive_threshold, self.cmplog_adaptive_window)
+        });
+        let ensemble_enabled = self.ensemble_profile.is_some();
+        let power_schedule = self
+            .ensemble_profile
+            .map(|p| p.power_schedule)
+            .unwrap_or(PowerSchedule::EXPLORE);
+        let max_size = self.ensemble_profile.and_then(|p| p.max_size);
+        let input_access = self.input_access.clone();
         let corpus_directory = self.corpus_directory.clone();
         let solutions_directory = self.solutions_directory.clone();
         let executable_tokens = self
@@ -175,12 +256,21 @@ impl Tsffs {
             .into_iter()
             .flatten()
             .collect::<Vec<_>>();
+        let src_file_integer_tokens = tokenize_src_file_integers(&self.token_src_files)?;
         let token_files = self.token_files.clone();
+        let custom_mutator_libraries = self.custom_mutator_libraries()?;
+        let custom_mutators_enabled = !custom_mutator_libraries.is_empty();
         let input_tokens = self.tokens.clone();
         let generate_random_corpus = self.generate_random_corpus;
         let initial_random_corpus_size = self.initial_random_corpus_size;
         let executor_timeout = self.executor_timeout;
         let debug_log_libafl = self.debug_log_libafl;
+        let remote_executors = self.remote_executors;
+        let remote_executors_enabled = remote_executors > 0;
+        let remote_executor_channels_path = self.remote_executor_channels_path.clone();
+        // NOTE: The start info is set before the fuzzer thread is started for all harnesses
+        // which provide a testcase buffer
+        let buffer_size = self.start_info.get().map(|si| si.size.maximum_size());
         let initial_contents = self
             .use_initial_as_corpus
             .then(|| {
@@ -217,13 +307,24 @@ impl Tsffs {
                         .ok();
                 }
 
+                let post_processors = CustomPostProcessors::new(&custom_mutator_libraries);
+
                 let mut harness = |input: &BytesInput| {
-                    let testcase = BytesInput::new(input.target_bytes().as_slice().to_vec());
+                    let Some(testcase) =
+                        post_processors.apply(input.target_bytes().as_slice().to_vec())
+                    else {
+                        // A post-processor discarded the input, so it is not executed
+                        return ExitKind::Ok;
+                    };
+                    let testcase = BytesInput::new(testcase);
+                    let span = timeline.as_ref().map(Timeline::now);
+
                     client
                         .borrow_mut()
                         .0
                         .send(Testcase {
                             testcase,
+                            name: input.generate_name(0),
                             cmplog: false,
                         })
                         .expect("Failed to send testcase message");
@@ -233,16 +334,29 @@ impl Tsffs {
                         Ok(m) => m,
                     };
 
+                    if let (Some(timeline), Some(span)) = (timeline.as_ref(), span) {
+                        timeline.record("wait for exit kind", TimelineThread::Fuzzer, span);
+                    }
+
                     status
                 };
 
                 let mut aflpp_cmp_harness = |input: &BytesInput| {
-                    let testcase = BytesInput::new(input.target_bytes().as_slice().to_vec());
+                    let Some(testcase) =
+                        post_processors.apply(input.target_bytes().as_slice().to_vec())
+                    else {
+                        // A post-processor discarded the input, so it is not executed
+                        return ExitKind::Ok;
+                    };
+                    let testcase = BytesInput::new(testcase);
+                    let span = timeline.as_ref().map(Timeline::now);
+
                     client
                         .borrow_mut()
                         .0
                         .send(Testcase {
                             testcase,
+                            name: input.generate_name(0),
                             cmplog: true,
                         })
                         .expect("Failed to send testcase message");
@@ -252,15 +366,21 @@ impl Tsffs {
                         Ok(m) => m,
                     };
 
+                    if let (Some(timeline), Some(span)) = (timeline.as_ref(), span) {
+                        timeline.record("wait for exit kind", TimelineThread::Fuzzer, span);
+                    }
+
                     status
                 };
 
                 let mut tracing_harness = aflpp_cmp_harness;
 
-                let edges_observer = HitcountsMapObserver::new(StdMapObserver::from_mut_slice(
+                // NOTE: Hit counts are classified on the simulator side by `finish_coverage` before
+                // each exit kind is reported, so the observer does not classify them again
+                let edges_observer = StdMapObserver::from_mut_slice(
                     Self::EDGES_OBSERVER_NAME,
                     OwnedMutSlice::from(coverage_map),
-                ));
+                );
 
                 let aflpp_cmp_observer = AFLppCmpLogObserver::new(
                     Self::AFLPP_CMP_OBSERVER_NAME,
@@ -274,12 +394,15 @@ impl Tsffs {
                     true,
                 );
                 let time_observer = TimeObserver::new(Self::TIME_OBSERVER_NAME);
+                let input_access_observer =
+                    InputAccessObserver::new(Self::INPUT_ACCESS_OBSERVER_NAME, input_access);
 
                 let map_feedback = ReportingMapFeedback::new(
                     MaxMapFeedback::tracking(&edges_observer, true, true),
                     mtx.clone(),
                 );
                 let time_feedback = TimeFeedback::with_observer(&time_observer);
+                let input_access_feedback = InputAccessFeedback::new(&input_access_observer);
 
                 let crash_feedback = CrashFeedback::new();
                 let timeout_feedback = TimeFeedback::new(Self::TIMEOUT_FEEDBACK_NAME);
@@ -308,7 +431,7 @@ impl Tsffs {
                 let colorization_stage = ColorizationStage::new(&edges_observer);
                 let generalization_stage = GeneralizationStage::new(&edges_observer);
 
-                let mut feedback = feedback_or!(map_feedback, time_feedback);
+                let mut feedback = feedback_or!(map_feedback, time_feedback, input_access_feedback);
                 let mut objective = feedback_or_fast!(crash_feedback, timeout_feedback);
 
                 let mut state = StdState::new(
@@ -329,13 +452,18 @@ impl Tsffs {
                 tokens.add_tokens(src_file_tokens);
                 tokens.add_tokens(input_tokens);
 
+                state.add_metadata(IntegerTokens::new(src_file_integer_tokens, &tokens));
                 state.add_metadata(tokens);
 
+                if let Some(max_size) = max_size {
+                    state.set_max_size(max_size);
+                }
+
                 let scheduler =
                     IndexesLenTimeMinimizerScheduler::new(StdWeightedScheduler::with_schedule(
                         &mut state,
                         &edges_observer,
-                        Some(PowerSchedule::EXPLORE),
+                        Some(power_schedule),
                     ));
 
                 let mut fuzzer = StdFuzzer::new(scheduler, feedback, objective);
@@ -350,55 +478,49 @@ impl Tsffs {
 
                 let mut manager = SimpleEventManager::new(monitor);
 
-                let mut executor = InProcessExecutor::with_timeout(
+                // A single watchdog detects a wedged simulator for all executors, instead of a
+                // host timer armed around every execution
+                let heartbeat = Heartbeat::default();
+                heartbeat
+                    .spawn_watchdog(Duration::from_secs(executor_timeout), timeline.clone())
+                    .map_err(|e| {
+                        eprintln!("Couldn't start fuzzer watchdog: {e}");
+                        e
+                    })?;
+
+                let mut executor = SimicsExecutor::new(
                     &mut harness,
-                    tuple_list!(edges_observer, time_observer),
-                    &mut fuzzer,
-                    &mut state,
-                    &mut manager,
-                    Duration::from_secs(executor_timeout),
-                )
-                .map_err(|e| {
-                    eprintln!("Couldn't initialize fuzzer executor: {e}");
-                    anyhow!("Couldn't initialize fuzzer executor: {e}")
-                })?;
+                    tuple_list!(edges_observer, time_observer, input_access_observer),
+                    heartbeat.clone(),
+                );
 
-                let aflpp_cmp_executor = InProcessExecutor::with_timeout(
+                let aflpp_cmp_executor = SimicsExecutor::new(
                     &mut aflpp_cmp_harness,
                     tuple_list!(aflpp_cmp_observer),
-                    &mut fuzzer,
-                    &mut state,
-                    &mut manager,
-                    Duration::from_secs(executor_timeout),
-                )
-                .map_err(|e| {
-                    eprintln!("Couldn't initialize fuzzer AFL++ cmplog executor: {e}");
-                    anyhow!("Couldn't initialize fuzzer AFL++ cmplog executor: {e}")
-                })?;
+                    heartbeat.clone(),
+                );
 
-                let tracing_executor = InProcessExecutor::with_timeout(
+                let tracing_executor = SimicsExecutor::new(
                     &mut tracing_harness,
                     tuple_list!(cmplog_observer),
-                    &mut fuzzer,
-                    &mut state,
-                    &mut manager,
-                    Duration::from_secs(executor_timeout),
-                )
-                .map_err(|e| {
-                    eprintln!("Couldn't initialize fuzzer AFL++ cmplog executor: {e}");
-                    anyhow!("Couldn't initialize fuzzer AFL++ cmplog executor: {e}")
-                })?;
+                    heartbeat.clone(),
+                );
 
                 let input_to_state_stage = StdMutationalStage::new(StdScheduledMutator::new(
                     tuple_list!(I2SRandReplace::new()),
                 ));
-                let havoc_mutational_stage = StdPowerMutationalStage::new(
-                    StdScheduledMutator::new(havoc_mutations().merge(tokens_mutations())),
-                );
+                let havoc_mutational_stage =
+                    StdPowerMutationalStage::new(StdScheduledMutator::new(
+                        havoc_mutations()
+                            .merge(tokens_mutations())
+                            .merge(tuple_list!(IntegerTokenReplace::new())),
+                    ));
                 let mopt_mutational_stage = StdPowerMutationalStage::new(
                     StdMOptMutator::new(
                         &mut state,
-                        havoc_mutations().merge(tokens_mutations()),
+                        havoc_mutations()
+                            .merge(tokens_mutations())
+                            .merge(tuple_list!(IntegerTokenReplace::new())),
                         7,
                         5,
                     )
@@ -407,6 +529,34 @@ impl Tsffs {
                         anyhow!("Couldn't initialize fuzzer MOpt mutator: {e}")
                     })?,
                 );
+                let custom_mutational_stage =
+                    StdMutationalStage::new(CustomMutator::new(&custom_mutator_libraries));
+                // Inputs for harnesses without a buffer are only bounded by the maximum size of
+                // mutated testcases
+                let remote_input_capacity = buffer_size.unwrap_or_else(|| state.max_size());
+                let remote_channels = (0..remote_executors)
+                    .map(|_| RemoteChannel::create(remote_input_capacity, Self::COVERAGE_MAP_SIZE))
+                    .collect::<Result<Vec<_>>>()
+                    .map_err(|e| {
+                        eprintln!("Couldn't create remote executor channels: {e}");
+                        e
+                    })?;
+                if remote_executors_enabled {
+                    write(
+                        &remote_executor_channels_path,
+                        to_string(&remote_channels.iter().map(|c| c.id()).collect::<Vec<_>>())?,
+                    )?;
+                }
+                let remote_mutational_stage = RemoteMutationalStage::new(
+                    remote_channels,
+                    StdScheduledMutator::new(
+                        havoc_mutations()
+                            .merge(tokens_mutations())
+                            .merge(tuple_list!(IntegerTokenReplace::new())),
+                    ),
+                    Self::EDGES_OBSERVER_NAME,
+                    Duration::from_secs(executor_timeout),
+                );
                 let redqueen_mutational_stage =
                     MultiMutationalStage::new(AFLppRedQueen::with_cmplog_options(true, true));
                 let aflpp_tracing_stage = AFLppCmplogTracingStage::with_cmplog_observer_name(
@@ -474,6 +624,60 @@ impl Tsffs {
                     );
                 }
 
+                // The executions of the stages which only analyze the current entry are not
+                // counted towards the yield of the adaptive comparison logging schedule
+                let analysis_executions = Rc::new(Cell::new(0));
+                let colorization_stage =
+                    AnalysisStage::new(colorization_stage, analysis_executions.clone());
+                let aflpp_tracing_stage =
+                    AnalysisStage::new(aflpp_tracing_stage, analysis_executions.clone());
+                let tracing_stage = AnalysisStage::new(tracing_stage, analysis_executions.clone());
+
+                // Each stage records a span on the timeline each time it is performed
+                let calibration_stage =
+                    TimedStage::new("calibration", calibration_stage, timeline.clone());
+                let generalization_stage =
+                    TimedStage::new("generalization", generalization_stage, timeline.clone());
+                let colorization_stage =
+                    TimedStage::new("colorization", colorization_stage, timeline.clone());
+                let aflpp_tracing_stage =
+                    TimedStage::new("cmplog tracing", aflpp_tracing_stage, timeline.clone());
+                let redqueen_mutational_stage =
+                    TimedStage::new("redqueen", redqueen_mutational_stage, timeline.clone());
+                let tracing_stage = TimedStage::new("cmp tracing", tracing_stage, timeline.clone());
+                let input_to_state_stage =
+                    TimedStage::new("input to state", input_to_state_stage, timeline.clone());
+                let havoc_mutational_stage =
+                    TimedStage::new("havoc", havoc_mutational_stage, timeline.clone());
+                let mopt_mutational_stage =
+                    TimedStage::new("mopt", mopt_mutational_stage, timeline.clone());
+                let custom_mutational_stage =
+                    TimedStage::new("custom mutators", custom_mutational_stage, timeline.clone());
+                let remote_mutational_stage = TimedStage::new(
+                    "remote executors",
+                    remote_mutational_stage,
+                    timeline.clone(),
+                );
+                let dump_corpus_stage =
+                    TimedStage::new("dump corpus", dump_corpus_stage, timeline.clone());
+                let synchronize_corpus_stage = TimedStage::new(
+                    "synchronize corpus",
+                    synchronize_corpus_stage,
+                    timeline.clone(),
+                );
+
+                // Entries added by the synchronization stage were found by other instances, so
+                // the corpus size before it is used to count the entries this instance found
+                let corpus_count_before_sync = Rc::new(Cell::new(0));
+                let sync_corpus_count = corpus_count_before_sync.clone();
+
+                // With the adaptive schedule, the comparison logging stages start disabled and
+                // entries scheduled before they are enabled have not been colorized yet, so the
+                // entries which have been are tracked instead of relying on the scheduled count
+                let cmplog_active = Cell::new(cmplog_enabled && adaptive_cmplog.is_none());
+                let cmplog_adaptive = adaptive_cmplog.is_some();
+                let cmplog_colorized = RefCell::new(HashSet::new());
+
                 let mut stages = tuple_list!(
                     calibration_stage,
                     generalization_stage,
@@ -483,34 +687,41 @@ impl Tsffs {
                          state: &mut StdState<_, CachedOnDiskCorpus<_>, _, _>,
                          _event_manager: &mut _|
                          -> Result<bool, libafl::Error> {
-                            Ok(cmplog_enabled
-                                && state
-                                    .corpus()
-                                    .get(
-                                        state
-                                            .current_corpus_idx()
-                                            .map_err(|e| {
-                                                eprintln!(
-                                                    "Error getting current corpus index: {e}"
-                                                );
-                                                // libafl::Error::unkown(format!(
-                                                //     "Error getting current corpus index: {e}"
-                                                // ))
-                                                e
-                                            })?
-                                            .ok_or_else(|| {
-                                                eprintln!("No current corpus index");
-
-                                                libafl::Error::unknown("No current corpus index")
-                                            })?,
-                                    )
-                                    .map_err(|e| {
-                                        eprintln!("Error getting current corpus entry: {e}");
-                                        e
-                                    })?
-                                    .borrow()
-                                    .scheduled_count()
-                                    == 1)
+                            if !cmplog_active.get() {
+                                return Ok(false);
+                            }
+
+                            let current_corpus_idx = state
+                                .current_corpus_idx()
+                                .map_err(|e| {
+                                    eprintln!("Error getting current corpus index: {e}");
+                                    // libafl::Error::unkown(format!(
+                                    //     "Error getting current corpus index: {e}"
+                                    // ))
+                                    e
+                                })?
+                                .ok_or_else(|| {
+                                    eprintln!("No current corpus index");
+
+                                    libafl::Error::unknown("No current corpus index")
+                                })?;
+
+                            if cmplog_adaptive {
+                                return Ok(cmplog_colorized
+                                    .borrow_mut()
+                                    .insert(current_corpus_idx));
+                            }
+
+                            Ok(state
+                                .corpus()
+                                .get(current_corpus_idx)
+                                .map_err(|e| {
+                                    eprintln!("Error getting current corpus entry: {e}");
+                                    e
+                                })?
+                                .borrow()
+                                .scheduled_count()
+                                == 1)
                         },
                         tuple_list!(
                             colorization_stage,
@@ -524,14 +735,44 @@ impl Tsffs {
                          _state: &mut StdState<_, CachedOnDiskCorpus<_>, _, _>,
                          _event_manager: &mut _|
                          -> Result<bool, libafl::Error> {
-                            Ok(cmplog_enabled)
+                            Ok(cmplog_active.get())
                         },
                         tuple_list!(tracing_stage, input_to_state_stage)
                     ),
                     havoc_mutational_stage,
                     mopt_mutational_stage,
+                    IfStage::new(
+                        |_fuzzer: &mut _,
+                         _executor: &mut _,
+                         _state: &mut StdState<_, CachedOnDiskCorpus<_>, _, _>,
+                         _event_manager: &mut _|
+                         -> Result<bool, libafl::Error> {
+                            Ok(custom_mutators_enabled)
+                        },
+                        tuple_list!(custom_mutational_stage)
+                    ),
+                    IfStage::new(
+                        |_fuzzer: &mut _,
+                         _executor: &mut _,
+                         _state: &mut StdState<_, CachedOnDiskCorpus<_>, _, _>,
+                         _event_manager: &mut _|
+                         -> Result<bool, libafl::Error> {
+                            Ok(remote_executors_enabled)
+                        },
+                        tuple_list!(remote_mutational_stage)
+                    ),
                     dump_corpus_stage,
-                    synchronize_corpus_stage,
+                    IfStage::new(
+                        move |_fuzzer: &mut _,
+                              _executor: &mut _,
+                              state: &mut StdState<_, CachedOnDiskCorpus<_>, _, _>,
+                              _event_manager: &mut _|
+                              -> Result<bool, libafl::Error> {
+                            sync_corpus_count.set(state.corpus().count());
+                            Ok(true)
+                        },
+                        tuple_list!(synchronize_corpus_stage)
+                    ),
                 );
 
                 loop {
@@ -540,12 +781,39 @@ impl Tsffs {
                         break;
                     }
 
+                    let corpus_count = state.corpus().count();
+                    let executions = *state.executions();
+                    analysis_executions.set(0);
+
                     fuzzer
                         .fuzz_one(&mut stages, &mut executor, &mut state, &mut manager)
                         .map_err(|e| {
                             eprintln!("Error running iteration of fuzzing loop: {e}");
                             anyhow!("Error running iteration of fuzzing loop: {e}")
                         })?;
+
+                    let found = corpus_count_before_sync.get().saturating_sub(corpus_count);
+
+                    if ensemble_enabled && found > 0 {
+                        mtx.send(FuzzerMessage::CorpusEntriesFound(found))
+                            .map_err(|e| anyhow!("Failed to send message: {e}"))?;
+                    }
+
+                    if let Some(adaptive_cmplog) = adaptive_cmplog.as_mut() {
+                        let executions = (state.executions().saturating_sub(executions) as u64)
+                            .saturating_sub(analysis_executions.get());
+
+                        if adaptive_cmplog.record(executions, found as u64) {
+                            cmplog_active.set(adaptive_cmplog.enabled());
+
+                            mtx.send(FuzzerMessage::CmplogYield {
+                                enabled: adaptive_cmplog.enabled(),
+                                without_cmplog: adaptive_cmplog.without_cmplog,
+                                with_cmplog: adaptive_cmplog.with_cmplog,
+                            })
+                            .map_err(|e| anyhow!("Failed to send message: {e}"))?;
+                        }
+                    }
                 }
 
                 println!("Fuzzing loop exited.");
@@ -557,6 +825,24 @@ impl Tsffs {
         Ok(())
     }
 
+    /// The custom mutator libraries in `custom_mutators`, loaded the first time they are
+    /// needed and shared by the fuzzer and repro afterward
+    pub fn custom_mutator_libraries(&mut self) -> Result<Vec<Arc<CustomMutatorLibrary>>> {
+        if let Some(libraries) = self.custom_mutator_libraries.as_ref() {
+            return Ok(libraries.clone());
+        }
+
+        let libraries = self
+            .custom_mutators
+            .iter()
+            .map(|f| CustomMutatorLibrary::load(f, current_nanos() as u32).map(Arc::new))
+            .collect::<Result<Vec<_>>>()?;
+
+        self.custom_mutator_libraries = Some(libraries.clone());
+
+        Ok(libraries)
+    }
+
     pub fn send_shutdown(&mut self) -> Result<()> {
         if let Some(stx) = self.fuzzer_shutdown.get_mut() {
             stx.send(ShutdownMessage::default())?;
@@ -568,16 +854,25 @@ impl Tsffs {
     pub fn get_testcase(&mut self) -> Result<Testcase> {
         let testcase = if let Some(testcase) = self.repro_testcase.as_ref() {
             debug!(self.as_conf_object(), "Using repro testcase");
+            let testcase = BytesInput::new(testcase.clone());
             Testcase {
-                testcase: BytesInput::new(testcase.clone()),
+                name: testcase.generate_name(0),
+                testcase,
                 cmplog: false,
             }
         } else {
-            self.fuzzer_rx
+            let span = self.span_start();
+
+            let testcase = self
+                .fuzzer_rx
                 .get_mut()
                 .ok_or_else(|| anyhow!("Fuzzer receiver not set"))?
                 .recv()
-                .map_err(|e| anyhow!("Error receiving from fuzzer: {e}"))?
+                .map_err(|e| anyhow!("Error receiving from fuzzer: {e}"))?;
+
+            self.record_span("wait for testcase", span);
+
+            testcase
         };
 
         if self.keep_all_corpus {
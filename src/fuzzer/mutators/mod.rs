@@ -0,0 +1,352 @@
+// Copyright (C) 2024 Intel Corporation
+// SPDX-License-Identifier: Apache-2.0
+
+//! Custom mutators and post-processors loaded from native shared libraries implementing the
+//! AFL++ custom mutator API. Each library must export `afl_custom_init` and may export
+//! `afl_custom_fuzz`, `afl_custom_post_process` and `afl_custom_deinit`:
+//!
+//! ```c
+//! void *afl_custom_init(void *afl, unsigned int seed);
+//! size_t afl_custom_fuzz(void *data, uint8_t *buf, size_t buf_size, uint8_t **out_buf,
+//!                        uint8_t *add_buf, size_t add_buf_size, size_t max_size);
+//! size_t afl_custom_post_process(void *data, uint8_t *buf, size_t buf_size,
+//!                                uint8_t **out_buf);
+//! void afl_custom_deinit(void *data);
+//! ```
+//!
+//! The `afl` argument to `afl_custom_init` and the `add_buf` argument to `afl_custom_fuzz` are
+//! always null. Output buffers remain owned by the library.
+
+use crate::fuzzer::tokenize::INTEGER_TOKEN_WIDTHS;
+use anyhow::{anyhow, Result};
+use libafl::{
+    inputs::HasBytesVec,
+    prelude::{BytesInput, MutationResult, Mutator, Tokens},
+    state::{HasMaxSize, HasMetadata, HasRand},
+};
+use libafl_bolts::{impl_serdeany, rands::Rand, Named};
+use libloading::Library;
+use serde::{Deserialize, Serialize};
+use std::{
+    collections::HashSet,
+    ffi::{c_uint, c_void},
+    path::{Path, PathBuf},
+    ptr::null_mut,
+    slice::from_raw_parts,
+    sync::Arc,
+};
+
+type InitFn = unsafe extern "C" fn(*mut c_void, c_uint) -> *mut c_void;
+type FuzzFn =
+    unsafe extern "C" fn(*mut c_void, *mut u8, usize, *mut *mut u8, *mut u8, usize, usize) -> usize;
+type PostProcessFn = unsafe extern "C" fn(*mut c_void, *mut u8, usize, *mut *mut u8) -> usize;
+type DeinitFn = unsafe extern "C" fn(*mut c_void);
+
+/// A loaded custom mutator library
+pub(crate) struct CustomMutatorLibrary {
+    /// The path the library was loaded from
+    path: PathBuf,
+    /// The state returned by the library's `afl_custom_init`
+    data: *mut c_void,
+    fuzz: Option<FuzzFn>,
+    post_process: Option<PostProcessFn>,
+    deinit: Option<DeinitFn>,
+    /// The library itself, which must outlive the function pointers above
+    _library: Library,
+}
+
+impl CustomMutatorLibrary {
+    /// Load a custom mutator library and initialize it with `seed`
+    pub fn load<P>(path: P, seed: u32) -> Result<Self>
+    where
+        P: AsRef<Path>,
+    {
+        let path = path.as_ref().to_path_buf();
+        let library = unsafe { Library::new(&path) }
+            .map_err(|e| anyhow!("Failed to load custom mutator {}: {e}", path.display()))?;
+
+        let init = unsafe { library.get::<InitFn>(b"afl_custom_init\0") }
+            .map(|s| *s)
+            .map_err(|e| {
+                anyhow!(
+                    "Custom mutator {} does not export afl_custom_init: {e}",
+                    path.display()
+                )
+            })?;
+        let fuzz = unsafe { library.get::<FuzzFn>(b"afl_custom_fuzz\0") }
+            .map(|s| *s)
+            .ok();
+        let post_process = unsafe { library.get::<PostProcessFn>(b"afl_custom_post_process\0") }
+            .map(|s| *s)
+            .ok();
+        let deinit = unsafe { library.get::<DeinitFn>(b"afl_custom_deinit\0") }
+            .map(|s| *s)
+            .ok();
+
+        if fuzz.is_none() && post_process.is_none() {
+            return Err(anyhow!(
+                "Custom mutator {} exports neither afl_custom_fuzz nor afl_custom_post_process",
+                path.display()
+            ));
+        }
+
+        let data = unsafe { init(null_mut(), seed) };
+
+        Ok(Self {
+            path,
+            data,
+            fuzz,
+            post_process,
+            deinit,
+            _library: library,
+        })
+    }
+
+    /// Whether the library provides a mutator
+    pub fn has_fuzz(&self) -> bool {
+        self.fuzz.is_some()
+    }
+
+    /// Whether the library provides a post-processor
+    pub fn has_post_process(&self) -> bool {
+        self.post_process.is_some()
+    }
+
+    /// Mutate `buf`, returning the mutated testcase or `None` if the library produced no output
+    fn fuzz(&self, buf: &[u8], max_size: usize) -> Option<Vec<u8>> {
+        let fuzz = self.fuzz?;
+        // NOTE: The library may write to the input buffer, so it is given a copy
+        let mut buf = buf.to_vec();
+        let mut out_buf = null_mut();
+        let size = unsafe {
+            fuzz(
+                self.data,
+                buf.as_mut_ptr(),
+                buf.len(),
+                &mut out_buf,
+                null_mut(),
+                0,
+                max_size,
+            )
+        };
+
+        (!out_buf.is_null() && size > 0)
+            .then(|| unsafe { from_raw_parts(out_buf, size.min(max_size)) }.to_vec())
+    }
+
+    /// Post-process `buf` before it is written to the target. Returns `buf` unchanged if the
+    /// library has no post-processor or produced no output buffer, and `None` if the library
+    /// returned a size of zero, which discards the input.
+    fn post_process(&self, buf: Vec<u8>) -> Option<Vec<u8>> {
+        let Some(post_process) = self.post_process else {
+            return Some(buf);
+        };
+        let mut buf = buf;
+        let mut out_buf = null_mut();
+        let size = unsafe { post_process(self.data, buf.as_mut_ptr(), buf.len(), &mut out_buf) };
+
+        if size == 0 {
+            None
+        } else if out_buf.is_null() {
+            Some(buf)
+        } else {
+            Some(unsafe { from_raw_parts(out_buf, size) }.to_vec())
+        }
+    }
+}
+
+// NOTE: The library is loaded once on the simulator thread and shared with the fuzzer thread.
+// It is only called by one thread at a time, because the simulator thread only post-processes
+// repro testcases while the fuzzer thread is waiting for the result of an execution.
+unsafe impl Send for CustomMutatorLibrary {}
+unsafe impl Sync for CustomMutatorLibrary {}
+
+impl Drop for CustomMutatorLibrary {
+    fn drop(&mut self) {
+        if let Some(deinit) = self.deinit {
+            unsafe { deinit(self.data) };
+        }
+    }
+}
+
+impl std::fmt::Debug for CustomMutatorLibrary {
+    fn fmt(&self, f: &mut std::fmt::Formatter<'_>) -> std::fmt::Result {
+        f.debug_struct("CustomMutatorLibrary")
+            .field("path", &self.path)
+            .field("fuzz", &self.fuzz.is_some())
+            .field("post_process", &self.post_process.is_some())
+            .finish()
+    }
+}
+
+#[derive(Debug)]
+/// Mutator which mutates each input with one randomly chosen custom mutator library
+pub(crate) struct CustomMutator {
+    libraries: Vec<Arc<CustomMutatorLibrary>>,
+}
+
+impl CustomMutator {
+    /// Create a mutator from the libraries which provide a mutator
+    pub fn new(libraries: &[Arc<CustomMutatorLibrary>]) -> Self {
+        Self {
+            libraries: libraries.iter().filter(|l| l.has_fuzz()).cloned().collect(),
+        }
+    }
+}
+
+impl Named for CustomMutator {
+    fn name(&self) -> &str {
+        "CustomMutator"
+    }
+}
+
+impl<S> Mutator<BytesInput, S> for CustomMutator
+where
+    S: HasRand + HasMaxSize,
+{
+    fn mutate(
+        &mut self,
+        state: &mut S,
+        input: &mut BytesInput,
+    ) -> Result<MutationResult, libafl::Error> {
+        if self.libraries.is_empty() {
+            return Ok(MutationResult::Skipped);
+        }
+
+        let index = state.rand_mut().below(self.libraries.len() as u64) as usize;
+
+        match self.libraries[index].fuzz(input.bytes(), state.max_size()) {
+            Some(mutated) => {
+                *input.bytes_mut() = mutated;
+                Ok(MutationResult::Mutated)
+            }
+            None => Ok(MutationResult::Skipped),
+        }
+    }
+}
+
+#[derive(Debug, Default, Clone)]
+/// The post-processors of all custom mutator libraries, applied in order to each testcase
+/// before it is written to the target
+pub(crate) struct CustomPostProcessors {
+    libraries: Vec<Arc<CustomMutatorLibrary>>,
+}
+
+impl CustomPostProcessors {
+    /// Create the post-processor chain from the libraries which provide a post-processor
+    pub fn new(libraries: &[Arc<CustomMutatorLibrary>]) -> Self {
+        Self {
+            libraries: libraries
+                .iter()
+                .filter(|l| l.has_post_process())
+                .cloned()
+                .collect(),
+        }
+    }
+
+    /// Apply each post-processor to `buf` in order. Returns `None` if any post-processor
+    /// discarded the input, in which case it must not be executed.
+    pub fn apply(&self, buf: Vec<u8>) -> Option<Vec<u8>> {
+        self.libraries
+            .iter()
+            .try_fold(buf, |buf, library| library.post_process(buf))
+    }
+}
+
+#[derive(Debug, Default, Clone, Serialize, Deserialize)]
+/// A dictionary of fixed-width integer constants extracted from target sources. It is kept
+/// apart from `Tokens` because integer tokens overwrite a field of their own width in place,
+/// where string tokens are also inserted and can be any length.
+pub(crate) struct IntegerTokens {
+    tokens: Vec<Vec<u8>>,
+}
+
+impl_serdeany!(IntegerTokens);
+
+impl IntegerTokens {
+    /// Create the dictionary from encoded integer constants, omitting any which are already
+    /// in the string token dictionary `strings`
+    pub fn new(tokens: Vec<Vec<u8>>, strings: &Tokens) -> Self {
+        let strings = strings.tokens().iter().collect::<HashSet<_>>();
+
+        Self {
+            tokens: tokens
+                .into_iter()
+                .filter(|t| !strings.contains(t))
+                .collect(),
+        }
+    }
+
+    /// The encoded integer constants in the dictionary
+    pub fn tokens(&self) -> &[Vec<u8>] {
+        &self.tokens
+    }
+}
+
+#[derive(Debug, Default)]
+/// Mutator which overwrites bytes of the input at a random offset with a random token from
+/// the `IntegerTokens` dictionary. Tokens are stored at the narrowest width which holds
+/// them, and are extended to a random wider width, so one token can fill a field of any
+/// width. A token whose top bit is set is extended with either zeroes or ones, because it
+/// may be an unsigned or a negative value.
+pub(crate) struct IntegerTokenReplace;
+
+impl IntegerTokenReplace {
+    /// Create a new integer token replacement mutator
+    pub fn new() -> Self {
+        Self
+    }
+}
+
+impl Named for IntegerTokenReplace {
+    fn name(&self) -> &str {
+        "IntegerTokenReplace"
+    }
+}
+
+impl<S> Mutator<BytesInput, S> for IntegerTokenReplace
+where
+    S: HasRand + HasMetadata,
+{
+    fn mutate(
+        &mut self,
+        state: &mut S,
+        input: &mut BytesInput,
+    ) -> Result<MutationResult, libafl::Error> {
+        let count = state
+            .metadata_map()
+            .get::<IntegerTokens>()
+            .map_or(0, |t| t.tokens().len());
+
+        if count == 0 {
+            return Ok(MutationResult::Skipped);
+        }
+
+        let index = state.rand_mut().below(count as u64) as usize;
+        let mut token = state
+            .metadata_map()
+            .get::<IntegerTokens>()
+            .map(|t| t.tokens()[index].clone())
+            .ok_or_else(|| libafl::Error::key_not_found("IntegerTokens not in state"))?;
+
+        let size = input.bytes().len();
+        let widths = INTEGER_TOKEN_WIDTHS
+            .into_iter()
+            .filter(|width| (token.len()..=size).contains(width))
+            .collect::<Vec<_>>();
+
+        if widths.is_empty() {
+            return Ok(MutationResult::Skipped);
+        }
+
+        let width = widths[state.rand_mut().below(widths.len() as u64) as usize];
+        let negative =
+            token.last().is_some_and(|b| b & 0x80 != 0) && state.rand_mut().below(2) == 0;
+        token.resize(width, if negative { 0xff } else { 0 });
+
+        let offset = state.rand_mut().below((size - token.len() + 1) as u64) as usize;
+        input.bytes_mut()[offset..offset + token.len()].copy_from_slice(&token);
+
+        Ok(MutationResult::Mutated)
+    }
+}
@@ -0,0 +1,120 @@
+// Copyright (C) 2024 Intel Corporation
+// SPDX-License-Identifier: Apache-2.0
+
+use libafl::{
+    inputs::HasTargetBytes,
+    prelude::{Observer, UsesInput},
+};
+use libafl_bolts::{impl_serdeany, AsSlice, Named};
+use serde::{Deserialize, Serialize};
+use std::sync::{Arc, Mutex};
+
+#[derive(Debug, Clone, Default)]
+/// The bytes of the testcase buffer read by the target during the current execution. Written
+/// by the simulator while the execution runs and read by the fuzzer after it completes.
+pub(crate) struct InputAccess {
+    /// Whether input accesses are being tracked
+    pub enabled: bool,
+    /// One entry per testcase byte, set if the byte was read
+    pub accessed: Vec<bool>,
+}
+
+impl InputAccess {
+    /// Reset the tracked accesses for a testcase of `len` bytes
+    pub fn reset(&mut self, len: usize) {
+        self.accessed.clear();
+        self.accessed.resize(len, false);
+    }
+
+    /// Record a read of `size` bytes at `offset` into the testcase buffer
+    pub fn record(&mut self, offset: usize, size: usize) {
+        let len = self.accessed.len();
+        let start = offset.min(len);
+        let end = offset.saturating_add(size).min(len);
+        self.accessed[start..end].fill(true);
+    }
+
+    /// The number of bytes of the testcase up to and including the highest offset read
+    pub fn consumed_length(&self) -> usize {
+        self.accessed
+            .iter()
+            .rposition(|accessed| *accessed)
+            .map(|i| i + 1)
+            .unwrap_or(0)
+    }
+
+    /// The accessed bytes as a bitmap with the least significant bit of each byte first
+    pub fn bitmap(&self) -> Vec<u8> {
+        self.accessed
+            .chunks(u8::BITS as usize)
+            .map(|chunk| {
+                chunk
+                    .iter()
+                    .enumerate()
+                    .fold(0u8, |byte, (i, accessed)| byte | ((*accessed as u8) << i))
+            })
+            .collect()
+    }
+}
+
+#[derive(Debug, Clone, Serialize, Deserialize)]
+/// Testcase metadata describing which bytes of the testcase the target read
+pub(crate) struct InputAccessMetadata {
+    /// The number of bytes of the testcase up to and including the highest offset read
+    pub consumed_length: usize,
+    /// A bitmap of the bytes of the testcase which were read
+    pub accessed: Vec<u8>,
+}
+
+impl_serdeany!(InputAccessMetadata);
+
+#[derive(Debug, Serialize, Deserialize)]
+/// Observer of the testcase bytes read by the target during each execution
+pub(crate) struct InputAccessObserver {
+    /// The name of the observer
+    name: String,
+    #[serde(skip)]
+    /// The accesses shared with the simulator
+    access: Arc<Mutex<InputAccess>>,
+}
+
+impl InputAccessObserver {
+    /// Create a new observer sharing `access` with the simulator
+    pub fn new(name: &str, access: Arc<Mutex<InputAccess>>) -> Self {
+        Self {
+            name: name.to_string(),
+            access,
+        }
+    }
+
+    /// Metadata for the accesses of the last execution, if accesses are being tracked
+    pub fn metadata(&self) -> Option<InputAccessMetadata> {
+        let access = self.access.lock().ok()?;
+
+        access.enabled.then(|| InputAccessMetadata {
+            consumed_length: access.consumed_length(),
+            accessed: access.bitmap(),
+        })
+    }
+}
+
+impl Named for InputAccessObserver {
+    fn name(&self) -> &str {
+        &self.name
+    }
+}
+
+impl<S> Observer<S> for InputAccessObserver
+where
+    S: UsesInput,
+    S::Input: HasTargetBytes,
+{
+    fn pre_exec(&mut self, _state: &mut S, input: &S::Input) -> Result<(), libafl::Error> {
+        self.access
+            .lock()
+            .map_err(|e| libafl::Error::unknown(format!("Failed to lock input access: {e}")))?
+            .reset(input.target_bytes().as_slice().len());
+
+        Ok(())
+    }
+}
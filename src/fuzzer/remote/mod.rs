@@ -0,0 +1,491 @@
+// Copyright (C) 2024 Intel Corporation
+// SPDX-License-Identifier: Apache-2.0
+
+//! Shared memory channels connecting a central fuzzer to remote executors
+//!
+//! The central fuzzer owns the corpus, scheduler and feedback state, and creates one channel
+//! per remote executor. A remote executor is another simulator instance which runs no fuzzer
+//! of its own. It attaches to its channel, runs each input it receives, and returns the exit
+//! kind and coverage map of the execution. Each channel is a single slot mailbox in a shared
+//! memory region laid out as:
+//!
+//! | Offset                  | Size           | Contents                                  |
+//! |-------------------------|----------------|-------------------------------------------|
+//! | 0                       | 4              | Slot state (`EMPTY`, `INPUT` or `RESULT`) |
+//! | 4                       | 4              | Whether an executor is attached           |
+//! | 8                       | 4              | Exit kind of the last execution           |
+//! | 16                      | 8              | Length of the input                       |
+//! | 64                      | input capacity | Input                                     |
+//! | 64 + input capacity     | coverage size  | Coverage map of the last execution        |
+
+use crate::fuzzer::{ShutdownMessage, Testcase};
+use anyhow::{anyhow, Result};
+use libafl::{
+    corpus::Corpus,
+    events::EventFirer,
+    executors::HasObservers,
+    fuzzer::ExecutionProcessor,
+    inputs::{BytesInput, HasBytesVec, Input, UsesInput},
+    mutators::{MutationResult, Mutator},
+    observers::{ObserversTuple, StdMapObserver},
+    prelude::ExitKind,
+    stages::Stage,
+    state::{HasCorpus, HasCurrentCorpusIdx, HasExecutions, HasRand, State, UsesState},
+};
+use libafl_bolts::{
+    shmem::{ShMem, ShMemId, ShMemProvider, StdShMemProvider},
+    tuples::MatchName,
+    AsMutSlice, AsSlice,
+};
+use std::{
+    marker::PhantomData,
+    sync::{
+        atomic::{AtomicU32, AtomicU64, Ordering},
+        mpsc::{Receiver, Sender},
+    },
+    thread::{sleep, yield_now},
+    time::{Duration, Instant},
+};
+
+/// The slot holds nothing and may be written by the fuzzer
+const EMPTY: u32 = 0;
+/// The slot holds an input and may be read by the executor
+const INPUT: u32 = 1;
+/// The slot holds a result and may be read by the fuzzer
+const RESULT: u32 = 2;
+
+/// The offset of the slot state
+const STATE_OFFSET: usize = 0;
+/// The offset of the attached flag
+const ATTACHED_OFFSET: usize = 4;
+/// The offset of the exit kind
+const EXIT_KIND_OFFSET: usize = 8;
+/// The offset of the input length
+const INPUT_LEN_OFFSET: usize = 16;
+/// The size of the header preceding the input
+const HEADER_SIZE: usize = 64;
+
+/// How long an idle executor waits between checks of its channel for an input
+const EXECUTOR_POLL_INTERVAL: Duration = Duration::from_micros(50);
+
+/// Encode an exit kind for the channel
+fn exit_kind_to_u32(exit_kind: &ExitKind) -> u32 {
+    match exit_kind {
+        ExitKind::Crash => 1,
+        ExitKind::Oom => 2,
+        ExitKind::Timeout => 3,
+        _ => 0,
+    }
+}
+
+/// Decode an exit kind from the channel
+fn exit_kind_from_u32(exit_kind: u32) -> ExitKind {
+    match exit_kind {
+        1 => ExitKind::Crash,
+        2 => ExitKind::Oom,
+        3 => ExitKind::Timeout,
+        _ => ExitKind::Ok,
+    }
+}
+
+/// A channel between the central fuzzer and one remote executor
+pub(crate) struct RemoteChannel {
+    /// The shared memory region holding the channel
+    shmem: <StdShMemProvider as ShMemProvider>::ShMem,
+    /// The provider the region was created or attached with, which must outlive it
+    _provider: StdShMemProvider,
+    /// The maximum size of an input
+    input_capacity: usize,
+    /// The size of the coverage map
+    coverage_size: usize,
+    /// Whether this end of the channel is the executor
+    executor: bool,
+    /// Whether the fuzzer gave up waiting for the result in the slot. A stale result is
+    /// discarded when it arrives instead of being evaluated.
+    stale: bool,
+}
+
+impl RemoteChannel {
+    /// Create a new channel for inputs of up to `input_capacity` bytes and a coverage map of
+    /// `coverage_size` bytes
+    pub fn create(input_capacity: usize, coverage_size: usize) -> Result<Self> {
+        let mut provider = StdShMemProvider::new()
+            .map_err(|e| anyhow!("Failed to create shared memory provider: {e}"))?;
+        let mut shmem = provider
+            .new_shmem(HEADER_SIZE + input_capacity + coverage_size)
+            .map_err(|e| anyhow!("Failed to create shared memory for channel: {e}"))?;
+        shmem.as_mut_slice()[..HEADER_SIZE].fill(0);
+
+        Ok(Self {
+            shmem,
+            _provider: provider,
+            input_capacity,
+            coverage_size,
+            executor: false,
+            stale: false,
+        })
+    }
+
+    /// Attach to a channel created by a central fuzzer as its executor, using the identifier
+    /// returned by the fuzzer's `id`
+    pub fn attach(id: &str) -> Result<Self> {
+        let mut parts = id.split(':');
+        let (Some(shmem_id), Some(input_capacity), Some(coverage_size), None) =
+            (parts.next(), parts.next(), parts.next(), parts.next())
+        else {
+            return Err(anyhow!("Invalid remote channel identifier '{id}'"));
+        };
+        let input_capacity = input_capacity.parse::<usize>()?;
+        let coverage_size = coverage_size.parse::<usize>()?;
+
+        let mut provider = StdShMemProvider::new()
+            .map_err(|e| anyhow!("Failed to create shared memory provider: {e}"))?;
+        let shmem = provider
+            .shmem_from_id_and_size(
+                ShMemId::from_string(shmem_id),
+                HEADER_SIZE + input_capacity + coverage_size,
+            )
+            .map_err(|e| anyhow!("Failed to attach to remote channel '{id}': {e}"))?;
+
+        let channel = Self {
+            shmem,
+            _provider: provider,
+            input_capacity,
+            coverage_size,
+            executor: true,
+            stale: false,
+        };
+
+        channel.attached().store(1, Ordering::Release);
+
+        Ok(channel)
+    }
+
+    /// The identifier an executor uses to attach to this channel
+    pub fn id(&self) -> String {
+        format!(
+            "{}:{}:{}",
+            self.shmem.id(),
+            self.input_capacity,
+            self.coverage_size
+        )
+    }
+
+    fn header_u32(&self, offset: usize) -> &AtomicU32 {
+        // NOTE: The header is at the start of the page aligned mapping, so every field is
+        // naturally aligned
+        unsafe { &*(self.shmem.as_slice().as_ptr().add(offset) as *const AtomicU32) }
+    }
+
+    fn header_u64(&self, offset: usize) -> &AtomicU64 {
+        unsafe { &*(self.shmem.as_slice().as_ptr().add(offset) as *const AtomicU64) }
+    }
+
+    fn state(&self) -> &AtomicU32 {
+        self.header_u32(STATE_OFFSET)
+    }
+
+    fn attached(&self) -> &AtomicU32 {
+        self.header_u32(ATTACHED_OFFSET)
+    }
+
+    fn input_range(&self) -> std::ops::Range<usize> {
+        HEADER_SIZE..HEADER_SIZE + self.input_capacity
+    }
+
+    fn coverage_range(&self) -> std::ops::Range<usize> {
+        HEADER_SIZE + self.input_capacity..HEADER_SIZE + self.input_capacity + self.coverage_size
+    }
+
+    /// Whether an executor is attached to the channel
+    pub fn is_attached(&self) -> bool {
+        self.attached().load(Ordering::Acquire) != 0
+    }
+
+    /// Whether the slot is free for a new input, discarding a stale result if one arrived
+    pub fn is_ready(&mut self) -> bool {
+        if self.stale && self.state().load(Ordering::Acquire) == RESULT {
+            self.release();
+        }
+
+        self.is_attached() && !self.stale && self.state().load(Ordering::Acquire) == EMPTY
+    }
+
+    /// Send an input to the executor. The input is truncated to the channel's capacity.
+    pub fn send_input(&mut self, input: &[u8]) {
+        let len = input.len().min(self.input_capacity);
+        let range = self.input_range();
+        self.shmem.as_mut_slice()[range][..len].copy_from_slice(&input[..len]);
+        self.header_u64(INPUT_LEN_OFFSET)
+            .store(len as u64, Ordering::Relaxed);
+        self.state().store(INPUT, Ordering::Release);
+    }
+
+    /// The exit kind of the execution of the last input, if its result has arrived. The
+    /// coverage map of the execution stays in the slot until it is released.
+    pub fn result(&self) -> Option<ExitKind> {
+        (self.state().load(Ordering::Acquire) == RESULT)
+            .then(|| exit_kind_from_u32(self.header_u32(EXIT_KIND_OFFSET).load(Ordering::Relaxed)))
+    }
+
+    /// Copy the coverage map of the last result into `coverage`
+    pub fn read_coverage(&self, coverage: &mut [u8]) {
+        let len = coverage.len().min(self.coverage_size);
+        coverage[..len].copy_from_slice(&self.shmem.as_slice()[self.coverage_range()][..len]);
+    }
+
+    /// Free the slot after reading a result
+    pub fn release(&mut self) {
+        self.stale = false;
+        self.state().store(EMPTY, Ordering::Release);
+    }
+
+    /// Stop waiting for the result of the input in the slot
+    pub fn abandon(&mut self) {
+        self.stale = true;
+    }
+
+    /// Take the input in the slot, if the fuzzer has sent one
+    pub fn take_input(&self) -> Option<Vec<u8>> {
+        (self.state().load(Ordering::Acquire) == INPUT).then(|| {
+            let len = self.header_u64(INPUT_LEN_OFFSET).load(Ordering::Relaxed) as usize;
+            self.shmem.as_slice()[self.input_range()][..len.min(self.input_capacity)].to_vec()
+        })
+    }
+
+    /// Return the exit kind and coverage map of the execution of the input in the slot
+    pub fn send_result(&mut self, exit_kind: &ExitKind, coverage: &[u8]) {
+        let len = coverage.len().min(self.coverage_size);
+        let range = self.coverage_range();
+        self.shmem.as_mut_slice()[range][..len].copy_from_slice(&coverage[..len]);
+        self.header_u32(EXIT_KIND_OFFSET)
+            .store(exit_kind_to_u32(exit_kind), Ordering::Relaxed);
+        self.state().store(RESULT, Ordering::Release);
+    }
+}
+
+impl Drop for RemoteChannel {
+    fn drop(&mut self) {
+        if self.executor {
+            self.attached().store(0, Ordering::Release);
+        }
+    }
+}
+
+/// Run this instance as a remote executor of the central fuzzer owning the channel `id`.
+/// Each input received on the channel is sent to the simulator as a testcase, and the exit
+/// kind and coverage map of its execution are returned on the channel, until a shutdown
+/// message is received.
+pub(crate) fn run_remote_executor(
+    id: &str,
+    coverage_map: &mut [u8],
+    testcase_tx: Sender<Testcase>,
+    exit_kind_rx: Receiver<ExitKind>,
+    shutdown_rx: Receiver<ShutdownMessage>,
+) -> Result<()> {
+    let mut channel = RemoteChannel::attach(id)?;
+
+    loop {
+        if shutdown_rx.try_recv().is_ok() {
+            break;
+        }
+
+        let Some(input) = channel.take_input().map(BytesInput::new) else {
+            sleep(EXECUTOR_POLL_INTERVAL);
+            continue;
+        };
+
+        coverage_map.fill(0);
+
+        testcase_tx
+            .send(Testcase {
+                name: input.generate_name(0),
+                testcase: input,
+                cmplog: false,
+            })
+            .map_err(|e| anyhow!("Failed to send testcase message: {e}"))?;
+
+        let exit_kind = exit_kind_rx
+            .recv()
+            .map_err(|e| anyhow!("Error receiving status: {e}"))?;
+
+        channel.send_result(&exit_kind, coverage_map);
+    }
+
+    Ok(())
+}
+
+/// Stage which queues a batch of mutations of the current corpus entry for the remote
+/// executors, sends a new input to each executor as soon as it returns the result of its last
+/// one, and evaluates each result as if it had been executed locally. Inputs still running
+/// when the batch has been sent stay in flight while the other stages run, and their results
+/// are evaluated the next time the stage runs.
+pub(crate) struct RemoteMutationalStage<M, S> {
+    /// The channels to the remote executors
+    channels: Vec<RemoteChannel>,
+    /// The input running on each remote executor and when it was sent, by channel index
+    in_flight: Vec<Option<(BytesInput, Instant)>>,
+    /// The mutator used to produce each input
+    mutator: M,
+    /// The name of the local executor's edges observer, whose map remote coverage is copied
+    /// into before it is evaluated
+    observer_name: &'static str,
+    /// How long to wait for a remote execution before abandoning it
+    timeout: Duration,
+    phantom: PhantomData<S>,
+}
+
+impl<M, S> RemoteMutationalStage<M, S> {
+    /// The number of inputs queued for each remote executor each time the stage runs
+    const INPUTS_PER_EXECUTOR: usize = 16;
+
+    /// Create a stage dispatching inputs produced by `mutator` over `channels`. Remote
+    /// coverage is copied into the map of the edges observer named `observer_name` before it
+    /// is evaluated.
+    pub fn new(
+        channels: Vec<RemoteChannel>,
+        mutator: M,
+        observer_name: &'static str,
+        timeout: Duration,
+    ) -> Self {
+        let in_flight = channels.iter().map(|_| None).collect();
+
+        Self {
+            channels,
+            in_flight,
+            mutator,
+            observer_name,
+            timeout,
+            phantom: PhantomData,
+        }
+    }
+}
+
+impl<M, S> UsesState for RemoteMutationalStage<M, S>
+where
+    S: State,
+{
+    type State = S;
+}
+
+impl<E, EM, M, S, Z> Stage<E, EM, Z> for RemoteMutationalStage<M, S>
+where
+    E: HasObservers + UsesState<State = S>,
+    EM: EventFirer<State = S>,
+    M: Mutator<BytesInput, S>,
+    S: State
+        + UsesInput<Input = BytesInput>
+        + HasCorpus
+        + HasCurrentCorpusIdx
+        + HasExecutions
+        + HasRand,
+    Z: ExecutionProcessor<E::Observers, State = S>,
+{
+    type Progress = ();
+
+    fn perform(
+        &mut self,
+        fuzzer: &mut Z,
+        executor: &mut E,
+        state: &mut S,
+        manager: &mut EM,
+    ) -> Result<(), libafl::Error> {
+        let Some(corpus_idx) = state.current_corpus_idx()? else {
+            return Err(libafl::Error::illegal_state("No current corpus index"));
+        };
+
+        let input = state.corpus().cloned_input_for_id(corpus_idx)?;
+
+        let mut remaining = self.channels.len() * Self::INPUTS_PER_EXECUTOR;
+
+        while remaining > 0 {
+            let mut progressed = false;
+
+            for index in 0..self.channels.len() {
+                let Some((_, sent)) = &self.in_flight[index] else {
+                    continue;
+                };
+
+                let Some(exit_kind) = self.channels[index].result() else {
+                    if sent.elapsed() > self.timeout {
+                        self.channels[index].abandon();
+                        self.in_flight[index] = None;
+                        progressed = true;
+                    }
+
+                    continue;
+                };
+
+                let Some((mutated, _)) = self.in_flight[index].take() else {
+                    continue;
+                };
+
+                progressed = true;
+
+                *state.executions_mut() += 1;
+
+                // Observers reset their maps before an execution, so the remote coverage map
+                // is copied in between the pre- and post-execution hooks
+                executor.observers_mut().pre_exec_all(state, &mutated)?;
+                let edges_observer = executor
+                    .observers_mut()
+                    .match_name_mut::<StdMapObserver<'static, u8, false>>(self.observer_name)
+                    .ok_or_else(|| {
+                        libafl::Error::key_not_found(format!(
+                            "No edges observer named {}",
+                            self.observer_name
+                        ))
+                    })?;
+                self.channels[index].read_coverage(edges_observer.as_mut_slice());
+                self.channels[index].release();
+                executor
+                    .observers_mut()
+                    .post_exec_all(state, &mutated, &exit_kind)?;
+
+                fuzzer.process_execution(
+                    state,
+                    manager,
+                    mutated,
+                    executor.observers(),
+                    &exit_kind,
+                    true,
+                )?;
+            }
+
+            for (index, channel) in self.channels.iter_mut().enumerate() {
+                if remaining == 0 {
+                    break;
+                }
+
+                if self.in_flight[index].is_some() || !channel.is_ready() {
+                    continue;
+                }
+
+                progressed = true;
+                remaining -= 1;
+
+                let mut mutated = input.clone();
+
+                if self.mutator.mutate(state, &mut mutated)? == MutationResult::Skipped {
+                    continue;
+                }
+
+                channel.send_input(mutated.bytes());
+                self.in_flight[index] = Some((mutated, Instant::now()));
+            }
+
+            if !progressed {
+                // With no input in flight, no executor is attached and idle, so nothing can
+                // be sent until one attaches or a stale result arrives
+                if self.in_flight.iter().all(Option::is_none) {
+                    break;
+                }
+
+                // Every executor is busy
+                yield_now();
+            }
+        }
+
+        Ok(())
+    }
+}
@@ -1,12 +1,17 @@
 // Copyright (C) 2024 Intel Corporation
 // SPDX-License-Identifier: Apache-2.0
 
-//! Tokenization of executables
+//! Tokenization of executables and source files
 
 use anyhow::Result;
 use goblin::{pe::Coff, Object};
 use libafl::prelude::{NaiveTokenizer, Tokenizer};
-use std::{fs::read, path::Path};
+use std::{
+    collections::{BTreeSet, HashMap},
+    fs::read,
+    mem::size_of,
+    path::Path,
+};
 
 // 3 character string minimum
 const STRING_TOKEN_MIN_LEN: usize = 3;
@@ -31,6 +36,311 @@ where
     Ok(tokens)
 }
 
+/// The widths, in bytes, integer constants are encoded and written at, narrowest first
+pub(crate) const INTEGER_TOKEN_WIDTHS: [usize; 4] = [1, 2, 4, 8];
+
+#[derive(Debug, Clone, PartialEq, Eq)]
+enum CToken {
+    Identifier(String),
+    Integer(i128),
+    Punctuation(u8),
+}
+
+/// Scan C source into identifiers, integer constants and punctuation, each with the line it
+/// starts on. Comments and string literals are skipped, character constants are converted
+/// to their integer value, and floating point constants are dropped.
+fn scan_c_source(source: &[u8]) -> Vec<(CToken, usize)> {
+    let mut tokens = Vec::new();
+    let mut line = 1;
+    let mut i = 0;
+
+    while i < source.len() {
+        let c = source[i];
+
+        match c {
+            b'\n' => {
+                line += 1;
+                i += 1;
+            }
+            b'/' if source.get(i + 1) == Some(&b'/') => {
+                while i < source.len() && source[i] != b'\n' {
+                    i += 1;
+                }
+            }
+            b'/' if source.get(i + 1) == Some(&b'*') => {
+                i += 2;
+                while i < source.len() && !source[i..].starts_with(b"*/") {
+                    line += (source[i] == b'\n') as usize;
+                    i += 1;
+                }
+                i += 2;
+            }
+            b'"' | b'\'' => {
+                let start = i + 1;
+                i = start;
+                while i < source.len() && source[i] != c && source[i] != b'\n' {
+                    i += if source[i] == b'\\' { 2 } else { 1 };
+                }
+                let end = i.min(source.len());
+                i += 1;
+
+                if c == b'\'' {
+                    if let Some(value) = parse_c_char(&source[start..end]) {
+                        tokens.push((CToken::Integer(value), line));
+                    }
+                }
+            }
+            c if c.is_ascii_digit()
+                || (c == b'.' && source.get(i + 1).is_some_and(u8::is_ascii_digit)) =>
+            {
+                let start = i;
+                while i < source.len()
+                    && (source[i].is_ascii_alphanumeric()
+                        || matches!(source[i], b'_' | b'.' | b'\'')
+                        || (matches!(source[i], b'+' | b'-')
+                            && matches!(source[i - 1], b'e' | b'E' | b'p' | b'P')
+                            && !source[start..].starts_with(b"0x")
+                            && !source[start..].starts_with(b"0X")))
+                {
+                    i += 1;
+                }
+
+                if let Some(value) = parse_c_integer(&source[start..i]) {
+                    tokens.push((CToken::Integer(value), line));
+                }
+            }
+            c if c.is_ascii_alphabetic() || c == b'_' => {
+                let start = i;
+                while i < source.len() && (source[i].is_ascii_alphanumeric() || source[i] == b'_') {
+                    i += 1;
+                }
+
+                // Character constants with an encoding prefix, like L'x', are scanned on the
+                // next iteration
+                tokens.push((
+                    CToken::Identifier(String::from_utf8_lossy(&source[start..i]).to_string()),
+                    line,
+                ));
+            }
+            c if c.is_ascii_whitespace() => i += 1,
+            c => {
+                tokens.push((CToken::Punctuation(c), line));
+                i += 1;
+            }
+        }
+    }
+
+    tokens
+}
+
+/// Parse a C integer constant, including its prefix, digit separators and suffix. Returns
+/// `None` for floating point constants and constants which do not fit in 64 bits.
+fn parse_c_integer(literal: &[u8]) -> Option<i128> {
+    let literal = String::from_utf8_lossy(literal).replace('\'', "");
+    let literal = literal.trim_end_matches(['u', 'U', 'l', 'L', 'z', 'Z']);
+    let lower = literal.to_ascii_lowercase();
+
+    let (digits, radix) = if let Some(digits) = lower.strip_prefix("0x") {
+        (digits, 16)
+    } else if let Some(digits) = lower.strip_prefix("0b") {
+        (digits, 2)
+    } else if lower.len() > 1 && lower.starts_with('0') {
+        (&lower[1..], 8)
+    } else {
+        (lower.as_str(), 10)
+    };
+
+    u64::from_str_radix(digits, radix).ok().map(i128::from)
+}
+
+/// Parse the contents of a C character constant. Multi-character constants like `'ABCD'` are
+/// commonly used as magic numbers and take the value compilers give them, with the first
+/// character in the most significant byte.
+fn parse_c_char(contents: &[u8]) -> Option<i128> {
+    let mut characters = Vec::new();
+    let mut i = 0;
+
+    while i < contents.len() {
+        if contents[i] != b'\\' {
+            characters.push(contents[i] as u64);
+            i += 1;
+            continue;
+        }
+
+        let escape = *contents.get(i + 1)?;
+        i += 2;
+
+        characters.push(match escape {
+            b'n' => b'\n' as u64,
+            b't' => b'\t' as u64,
+            b'r' => b'\r' as u64,
+            b'a' => 0x07,
+            b'b' => 0x08,
+            b'f' => 0x0c,
+            b'v' => 0x0b,
+            b'x' => {
+                let start = i;
+                while i < contents.len() && contents[i].is_ascii_hexdigit() {
+                    i += 1;
+                }
+                u64::from_str_radix(std::str::from_utf8(&contents[start..i]).ok()?, 16).ok()?
+            }
+            b'0'..=b'7' => {
+                let start = i - 1;
+                while i < contents.len() && i < start + 3 && (b'0'..=b'7').contains(&contents[i]) {
+                    i += 1;
+                }
+                u64::from_str_radix(std::str::from_utf8(&contents[start..i]).ok()?, 8).ok()?
+            }
+            c => c as u64,
+        });
+    }
+
+    (!characters.is_empty() && characters.len() <= size_of::<u64>()).then(|| {
+        characters
+            .iter()
+            .fold(0u64, |value, c| value << 8 | (c & 0xff)) as i128
+    })
+}
+
+/// Extract the integer constants from C source: numeric and character constants, which also
+/// covers the values of `#define` constants, and the values of enumerators, including
+/// enumerators whose value is implicit or given by another constant's name. Negated constants
+/// are returned as negative values.
+fn c_integer_constants(source: &[u8]) -> BTreeSet<i128> {
+    let tokens = scan_c_source(source);
+    let mut constants = BTreeSet::new();
+    let mut names = HashMap::new();
+
+    let is_operand_end = |token: &CToken| {
+        matches!(
+            token,
+            CToken::Identifier(_)
+                | CToken::Integer(_)
+                | CToken::Punctuation(b')')
+                | CToken::Punctuation(b']')
+        )
+    };
+
+    for (index, (token, line)) in tokens.iter().enumerate() {
+        match token {
+            CToken::Integer(value) => {
+                let negated = index >= 1
+                    && tokens[index - 1].0 == CToken::Punctuation(b'-')
+                    && (index < 2 || !is_operand_end(&tokens[index - 2].0));
+
+                constants.insert(if negated { -value } else { *value });
+            }
+            CToken::Identifier(directive) if directive == "define" => {
+                // #define NAME [-]VALUE, with the value on the same line
+                if let [(CToken::Identifier(name), _), rest @ ..] = &tokens[index + 1..] {
+                    let value = match rest {
+                        [(CToken::Integer(value), l), ..] if l == line => Some(*value),
+                        [(CToken::Punctuation(b'-'), l), (CToken::Integer(value), _), ..]
+                            if l == line =>
+                        {
+                            Some(-value)
+                        }
+                        _ => None,
+                    };
+
+                    if let Some(value) = value {
+                        names.insert(name.clone(), value);
+                    }
+                }
+            }
+            CToken::Identifier(keyword) if keyword == "enum" => {
+                let Some(open) = tokens[index + 1..]
+                    .iter()
+                    .take(2)
+                    .position(|(t, _)| *t == CToken::Punctuation(b'{'))
+                else {
+                    continue;
+                };
+
+                let mut next = Some(0i128);
+                let mut position = index + 1 + open + 1;
+
+                while let Some((CToken::Identifier(name), _)) = tokens.get(position) {
+                    let expression_end = tokens[position + 1..]
+                        .iter()
+                        .position(|(t, _)| {
+                            matches!(t, CToken::Punctuation(b',') | CToken::Punctuation(b'}'))
+                        })
+                        .map(|end| position + 1 + end)
+                        .unwrap_or(tokens.len());
+
+                    let value = match &tokens[position + 1..expression_end] {
+                        [] => next,
+                        [(CToken::Punctuation(b'='), _), initializer @ ..] => match initializer {
+                            [(CToken::Integer(value), _)] => Some(*value),
+                            [(CToken::Punctuation(b'-'), _), (CToken::Integer(value), _)] => {
+                                Some(-value)
+                            }
+                            [(CToken::Identifier(other), _)] => names.get(other).copied(),
+                            _ => None,
+                        },
+                        _ => None,
+                    };
+
+                    if let Some(value) = value {
+                        constants.insert(value);
+                        names.insert(name.clone(), value);
+                    }
+
+                    next = value.map(|v| v + 1);
+
+                    if tokens.get(expression_end).map(|(t, _)| t)
+                        != Some(&CToken::Punctuation(b','))
+                    {
+                        break;
+                    }
+
+                    position = expression_end + 1;
+                }
+            }
+            _ => {}
+        }
+    }
+
+    constants
+}
+
+/// Extract integer constants from C source files and encode each one as a little endian
+/// token at the narrowest width in `INTEGER_TOKEN_WIDTHS` which can hold it as either a
+/// signed or an unsigned value. Encoding each constant once keeps the dictionary small, and
+/// `IntegerTokenReplace` extends tokens to wider fields when it writes them. All
+/// architectures the fuzzer supports are little endian. The values -1, 0 and 1 are omitted,
+/// because havoc mutations already produce them.
+pub fn tokenize_src_file_integers<I, P>(source_files: I) -> Result<Vec<Vec<u8>>>
+where
+    I: IntoIterator<Item = P>,
+    P: AsRef<Path>,
+{
+    let mut constants = BTreeSet::new();
+
+    source_files.into_iter().try_for_each(|f| {
+        read(f.as_ref()).map(|source| constants.extend(c_integer_constants(&source)))
+    })?;
+
+    let tokens = constants
+        .into_iter()
+        .filter(|value| !(-1..=1).contains(value))
+        .filter_map(|value| {
+            INTEGER_TOKEN_WIDTHS.into_iter().find_map(|width| {
+                let bits = (width * u8::BITS as usize) as u32;
+                let fits = value >= -(1i128 << (bits - 1)) && value < (1i128 << bits);
+
+                fits.then(|| (value as u64).to_le_bytes()[..width].to_vec())
+            })
+        })
+        .collect::<BTreeSet<_>>()
+        .into_iter()
+        .collect();
+
+    Ok(tokens)
+}
+
 fn tokenize_strings(bytes: &[u8]) -> Result<Vec<Vec<u8>>> {
     const WCHAR_SIZE: usize = 2;
     let mut tokens = Vec::new();
@@ -7,9 +7,10 @@ use std::time::SystemTime;
 
 use crate::{
     arch::ArchitectureOperations,
+    log::{LogMessage, LogMessageStopped},
     magic::MagicNumber,
     state::{SolutionKind, StopReason},
-    ManualStartInfo, Tsffs,
+    ManualStartInfo, StartInfo, Tsffs,
 };
 use anyhow::{anyhow, bail, Result};
 use libafl::prelude::ExitKind;
@@ -22,15 +23,109 @@ use simics::{
 };
 
 impl Tsffs {
+    /// Check each configured campaign stop condition. If one is met, log the final campaign
+    /// statistics, shut down the fuzzer, and quit the simulator. This must be called after the
+    /// exit kind of the iteration has been sent to the fuzzer.
+    fn stop_campaign_if_needed(&mut self) -> Result<()> {
+        let now = SystemTime::now();
+        let start_time = *self
+            .start_time
+            .get()
+            .ok_or_else(|| anyhow!("Start time was not set"))?;
+        let duration = now.duration_since(start_time)?;
+
+        if self.virtual_time_limit > 0.0 {
+            let start_processor = self
+                .start_processor()
+                .ok_or_else(|| anyhow!("No start processor"))?;
+            let iteration_end_virtual_time = start_processor.cycle().get_time()?;
+            self.virtual_time_elapsed +=
+                iteration_end_virtual_time - self.iteration_start_virtual_time;
+        }
+
+        let since_new_coverage =
+            now.duration_since(self.last_new_coverage_time.unwrap_or(start_time))?;
+
+        let reason = if self.iteration_limit != 0 && self.iterations >= self.iteration_limit {
+            format!("Configured iteration count {} reached", self.iterations)
+        } else if self.solution_limit != 0 && self.solutions >= self.solution_limit {
+            format!("Configured solution count {} reached", self.solutions)
+        } else if self.time_limit > 0.0 && duration.as_secs_f64() >= self.time_limit {
+            format!(
+                "Configured time limit of {} seconds reached",
+                self.time_limit
+            )
+        } else if self.virtual_time_limit > 0.0
+            && self.virtual_time_elapsed >= self.virtual_time_limit
+        {
+            format!(
+                "Configured virtual time limit of {} seconds reached",
+                self.virtual_time_limit
+            )
+        } else if self.plateau_iterations != 0
+            && self.iterations - self.last_new_coverage_iteration >= self.plateau_iterations
+        {
+            format!(
+                "No new coverage found in {} iterations",
+                self.iterations - self.last_new_coverage_iteration
+            )
+        } else if self.plateau_time > 0.0 && since_new_coverage.as_secs_f64() >= self.plateau_time {
+            format!(
+                "No new coverage found in {} seconds",
+                since_new_coverage.as_secs_f32()
+            )
+        } else {
+            return Ok(());
+        };
+
+        // Set the log level so this message always prints
+        set_log_level(self.as_conf_object_mut(), LogLevel::Info)?;
+
+        info!(
+            self.as_conf_object(),
+            "{reason}. Stopping after {} seconds ({} exec/s, {} edges).",
+            duration.as_secs_f32(),
+            self.iterations as f32 / duration.as_secs_f32(),
+            self.edges_seen.len()
+        );
+
+        // Log any messages the fuzzer sent since the last stop before the final statistics
+        self.log_messages()?;
+        self.log(LogMessage::Stopped(LogMessageStopped {
+            reason,
+            iterations: self.iterations,
+            solutions: self.solutions,
+            edges: self.edges_seen.len(),
+            elapsed_seconds: duration.as_secs_f64(),
+            virtual_seconds: self.virtual_time_elapsed,
+        }))?;
+
+        // The fuzzer only asks for the next testcase once it has processed the exit kind of this
+        // iteration, so waiting for that request ensures the testcase which reached the limit is
+        // evaluated and, if it is a solution, saved before quitting. If the fuzzer has already
+        // exited, there is nothing to wait for.
+        if let Some(fuzzer_rx) = self.fuzzer_rx.get_mut() {
+            let _ = fuzzer_rx.recv();
+        }
+
+        self.send_shutdown()?;
+
+        if let Some(timeline) = self.timeline.as_ref() {
+            timeline.finish();
+        }
+
+        quit(0)?;
+
+        Ok(())
+    }
+
     fn on_simulation_stopped_magic_start(&mut self, magic_number: MagicNumber) -> Result<()> {
         if !self.have_initial_snapshot() {
-            self.start_fuzzer_thread()?;
-
             let start_processor = self
                 .start_processor()
                 .ok_or_else(|| anyhow!("No start processor"))?;
 
-            let start_info = match magic_number {
+            let mut start_info = match magic_number {
                 MagicNumber::StartBufferPtrSizePtr => {
                     start_processor.get_magic_start_buffer_ptr_size_ptr()?
                 }
@@ -40,19 +135,31 @@ impl Tsffs {
                 MagicNumber::StartBufferPtrSizePtrVal => {
                     start_processor.get_magic_start_buffer_ptr_size_ptr_val()?
                 }
+                MagicNumber::StartRegisters => start_processor.get_magic_start_registers()?,
                 MagicNumber::StopNormal => unreachable!("StopNormal is not handled here"),
                 MagicNumber::StopAssert => unreachable!("StopAssert is not handled here"),
+                MagicNumber::Guard => unreachable!("Guard is not handled here"),
             };
 
+            self.reserve_testcase_buffer_guard(&mut start_info)?;
+
             debug!(self.as_conf_object(), "Start info: {start_info:?}");
 
             self.start_info
                 .set(start_info)
                 .map_err(|_| anyhow!("Failed to set start size"))?;
+            // The fuzzer thread is started once the start info is known, because the size of the
+            // testcase buffer sizes the channels to remote executors
+            self.start_fuzzer_thread()?;
             self.start_time
                 .set(SystemTime::now())
                 .map_err(|_| anyhow!("Failed to set start time"))?;
             self.coverage_enabled = true;
+            self.clear_branch_recorder()?;
+            self.quiesce_interrupts_if_needed()?;
+            self.capture_trace_address_space_if_needed()?;
+            self.watch_input_buffer_if_needed()?;
+            self.guard_regions_if_needed()?;
             self.save_initial_snapshot()?;
             self.get_and_write_testcase()?;
             self.post_timeout_event()?;
@@ -85,6 +192,7 @@ impl Tsffs {
 
             if self.repro_bookmark_set {
                 self.stopped_for_repro = true;
+                self.restore_interrupts_if_needed()?;
                 let current_log_level = log_level(self.as_conf_object_mut())?;
 
                 if current_log_level < LogLevel::Info as u32 {
@@ -102,29 +210,7 @@ impl Tsffs {
 
             self.iterations += 1;
 
-            if self.iteration_limit != 0 && self.iterations >= self.iteration_limit {
-                let duration = SystemTime::now().duration_since(
-                    *self
-                        .start_time
-                        .get()
-                        .ok_or_else(|| anyhow!("Start time was not set"))?,
-                )?;
-
-                // Set the log level so this message always prints
-                set_log_level(self.as_conf_object_mut(), LogLevel::Info)?;
-
-                info!(
-                    self.as_conf_object(),
-                    "Configured iteration count {} reached. Stopping after {} seconds ({} exec/s).",
-                    self.iterations,
-                    duration.as_secs_f32(),
-                    self.iterations as f32 / duration.as_secs_f32()
-                );
-
-                self.send_shutdown()?;
-
-                quit(0)?;
-            }
+            self.finish_coverage()?;
 
             let fuzzer_tx = self
                 .fuzzer_tx
@@ -133,8 +219,11 @@ impl Tsffs {
 
             fuzzer_tx.send(ExitKind::Ok)?;
 
+            self.stop_campaign_if_needed()?;
+
             self.restore_initial_snapshot()?;
-            self.coverage_prev_loc = 0;
+            self.reset_trace_state();
+            self.remove_iteration_guards()?;
 
             if self.start_info.get().is_some() {
                 self.get_and_write_testcase()?;
@@ -162,11 +251,14 @@ impl Tsffs {
         match magic_number {
             MagicNumber::StartBufferPtrSizePtr
             | MagicNumber::StartBufferPtrSizeVal
-            | MagicNumber::StartBufferPtrSizePtrVal => {
+            | MagicNumber::StartBufferPtrSizePtrVal
+            | MagicNumber::StartRegisters => {
                 self.on_simulation_stopped_magic_start(magic_number)?
             }
             MagicNumber::StopNormal => self.on_simulation_stopped_magic_stop()?,
             MagicNumber::StopAssert => self.on_simulation_stopped_magic_assert()?,
+            // Guard harnesses are handled without stopping the simulation
+            MagicNumber::Guard => {}
         }
 
         Ok(())
@@ -178,21 +270,28 @@ impl Tsffs {
         info: ManualStartInfo,
     ) -> Result<()> {
         if !self.have_initial_snapshot() {
-            self.start_fuzzer_thread()?;
             self.add_processor(processor, true)?;
 
-            let start_info = self
+            let mut start_info = self
                 .start_processor()
                 .ok_or_else(|| anyhow!("No start processor"))?
                 .get_manual_start_info(&info)?;
 
+            self.reserve_testcase_buffer_guard(&mut start_info)?;
+
             self.start_info
                 .set(start_info)
                 .map_err(|_| anyhow!("Failed to set start info"))?;
+            self.start_fuzzer_thread()?;
             self.start_time
                 .set(SystemTime::now())
                 .map_err(|_| anyhow!("Failed to set start time"))?;
             self.coverage_enabled = true;
+            self.clear_branch_recorder()?;
+            self.quiesce_interrupts_if_needed()?;
+            self.capture_trace_address_space_if_needed()?;
+            self.watch_input_buffer_if_needed()?;
+            self.guard_regions_if_needed()?;
             self.save_initial_snapshot()?;
 
             self.get_and_write_testcase()?;
@@ -224,8 +323,60 @@ impl Tsffs {
                 .set(SystemTime::now())
                 .map_err(|_| anyhow!("Failed to set start time"))?;
             self.coverage_enabled = true;
+            self.clear_branch_recorder()?;
+            self.quiesce_interrupts_if_needed()?;
+            self.capture_trace_address_space_if_needed()?;
+            self.watch_input_buffer_if_needed()?;
+            self.guard_regions_if_needed()?;
+            self.save_initial_snapshot()?;
+
+            self.post_timeout_event()?;
+        }
+
+        self.save_repro_bookmark_if_needed()?;
+
+        debug!(self.as_conf_object(), "Resuming simulation");
+
+        run_alone(|| {
+            continue_simulation(0)?;
+            Ok(())
+        })?;
+
+        Ok(())
+    }
+
+    fn on_simulation_stopped_with_checkpoint_start(
+        &mut self,
+        processor: *mut ConfObject,
+        info: Option<StartInfo>,
+    ) -> Result<()> {
+        if !self.have_initial_snapshot() {
+            self.started_from_checkpoint = true;
+            self.add_processor(processor, true)?;
+
+            if let Some(start_info) = info {
+                self.start_info
+                    .set(start_info)
+                    .map_err(|_| anyhow!("Failed to set start info"))?;
+            }
+
+            self.start_fuzzer_thread()?;
+
+            self.start_time
+                .set(SystemTime::now())
+                .map_err(|_| anyhow!("Failed to set start time"))?;
+            self.coverage_enabled = true;
+            self.clear_branch_recorder()?;
+            self.quiesce_interrupts_if_needed()?;
+            self.capture_trace_address_space_if_needed()?;
+            self.watch_input_buffer_if_needed()?;
+            self.guard_regions_if_needed()?;
             self.save_initial_snapshot()?;
 
+            if self.start_info.get().is_some() {
+                self.get_and_write_testcase()?;
+            }
+
             self.post_timeout_event()?;
         }
 
@@ -252,6 +403,7 @@ impl Tsffs {
 
             if self.repro_bookmark_set {
                 self.stopped_for_repro = true;
+                self.restore_interrupts_if_needed()?;
                 let current_log_level = log_level(self.as_conf_object_mut())?;
 
                 if current_log_level < LogLevel::Info as u32 {
@@ -269,29 +421,7 @@ impl Tsffs {
 
             self.iterations += 1;
 
-            if self.iteration_limit != 0 && self.iterations >= self.iteration_limit {
-                let duration = SystemTime::now().duration_since(
-                    *self
-                        .start_time
-                        .get()
-                        .ok_or_else(|| anyhow!("Start time was not set"))?,
-                )?;
-
-                // Set the log level so this message always prints
-                set_log_level(self.as_conf_object_mut(), LogLevel::Info)?;
-
-                info!(
-                    self.as_conf_object(),
-                    "Configured iteration count {} reached. Stopping after {} seconds ({} exec/s).",
-                    self.iterations,
-                    duration.as_secs_f32(),
-                    self.iterations as f32 / duration.as_secs_f32()
-                );
-
-                self.send_shutdown()?;
-
-                quit(0)?;
-            }
+            self.finish_coverage()?;
 
             let fuzzer_tx = self
                 .fuzzer_tx
@@ -300,8 +430,11 @@ impl Tsffs {
 
             fuzzer_tx.send(ExitKind::Ok)?;
 
+            self.stop_campaign_if_needed()?;
+
             self.restore_initial_snapshot()?;
-            self.coverage_prev_loc = 0;
+            self.reset_trace_state();
+            self.remove_iteration_guards()?;
 
             if self.start_info.get().is_some() {
                 self.get_and_write_testcase()?;
@@ -336,6 +469,7 @@ impl Tsffs {
 
             if self.repro_bookmark_set {
                 self.stopped_for_repro = true;
+                self.restore_interrupts_if_needed()?;
                 let current_log_level = log_level(self.as_conf_object_mut())?;
 
                 if current_log_level < LogLevel::Info as u32 {
@@ -352,29 +486,18 @@ impl Tsffs {
             }
 
             self.iterations += 1;
+            self.solutions += 1;
 
-            if self.iteration_limit != 0 && self.iterations >= self.iteration_limit {
-                let duration = SystemTime::now().duration_since(
-                    *self
-                        .start_time
-                        .get()
-                        .ok_or_else(|| anyhow!("Start time was not set"))?,
-                )?;
+            // Coverage is finished first so the branch recorder's arcs are in the recent edges
+            self.finish_coverage()?;
 
-                // Set the log level so this message always prints
-                set_log_level(self.as_conf_object_mut(), LogLevel::Info)?;
-
-                info!(
+            // Failing to capture the state should not stop the campaign, the solution is still
+            // saved and can be reproduced
+            if let Err(e) = self.capture_solution_state_if_needed(kind.clone()) {
+                warn!(
                     self.as_conf_object(),
-                    "Configured iteration count {} reached. Stopping after {} seconds ({} exec/s).",
-                    self.iterations,
-                    duration.as_secs_f32(),
-                    self.iterations as f32 / duration.as_secs_f32()
+                    "Failed to capture solution state: {e}"
                 );
-
-                self.send_shutdown()?;
-
-                quit(0)?;
             }
 
             let fuzzer_tx = self
@@ -389,8 +512,11 @@ impl Tsffs {
                 }
             }
 
+            self.stop_campaign_if_needed()?;
+
             self.restore_initial_snapshot()?;
-            self.coverage_prev_loc = 0;
+            self.reset_trace_state();
+            self.remove_iteration_guards()?;
 
             if self.start_info.get().is_some() {
                 self.get_and_write_testcase()?;
@@ -415,10 +541,14 @@ impl Tsffs {
     }
 
     fn on_simulation_stopped_with_reason(&mut self, reason: StopReason) -> Result<()> {
-        debug!(
-            self.as_conf_object(),
-            "Simulation stopped with reason {reason:?}"
-        );
+        // The full reason is only formatted when it will be logged, because this runs on every
+        // stop of every iteration
+        if log_level(self.as_conf_object_mut())? >= LogLevel::Debug as u32 {
+            debug!(
+                self.as_conf_object(),
+                "Simulation stopped with reason {reason:?}"
+            );
+        }
 
         match reason {
             StopReason::Magic { magic_number } => {
@@ -430,6 +560,9 @@ impl Tsffs {
             StopReason::ManualStartWithoutBuffer { processor } => {
                 self.on_simulation_stopped_manual_start_without_buffer(processor)
             }
+            StopReason::CheckpointStart { processor, info } => {
+                self.on_simulation_stopped_with_checkpoint_start(processor, info)
+            }
             StopReason::ManualStop => self.on_simulation_stopped_manual_stop(),
             StopReason::Solution { kind } => self.on_simulation_stopped_solution(kind),
         }
@@ -441,6 +574,8 @@ impl Tsffs {
             // stopped for a reason unrelated to fuzzing (like the user using the CLI)
             self.cancel_timeout_event()?;
 
+            self.finish_coverage()?;
+
             let fuzzer_tx = self
                 .fuzzer_tx
                 .get()
@@ -482,20 +617,32 @@ impl Tsffs {
             return Ok(());
         }
 
+        let span = self.span_start();
+
+        if let Some(run_span_start) = self.run_span_start.take() {
+            self.record_span("run", Some(run_span_start));
+        }
+
         //  Log information from the fuzzer
         self.log_messages()?;
 
-        if let Some(reason) = self.stop_reason.take() {
+        let result = if let Some(reason) = self.stop_reason.take() {
             self.on_simulation_stopped_with_reason(reason)
         } else {
             self.on_simulation_stopped_without_reason()
-        }
+        };
+
+        self.record_span("stop", span);
+        self.run_span_start = self.span_start();
+
+        result
     }
 
     /// Called on core exception HAP. Check to see if this exception is configured as a solution
     /// or all exceptions are solutions and trigger a stop if so
     pub fn on_exception(&mut self, _obj: *mut ConfObject, exception: i64) -> Result<()> {
         if self.all_exceptions_are_solutions || self.exceptions.contains(&exception) {
+            self.solution_exception = Some(exception);
             self.stop_simulation(StopReason::Solution {
                 kind: SolutionKind::Exception,
             })?;
@@ -511,7 +658,14 @@ impl Tsffs {
         breakpoint: i64,
         transaction: *mut GenericTransaction,
     ) -> Result<()> {
-        if self.all_breakpoints_are_solutions || self.breakpoints.contains(&(breakpoint as i32)) {
+        if self.input_access_breakpoint == Some(breakpoint as i32) {
+            return self.log_input_access(transaction);
+        }
+
+        if self.all_breakpoints_are_solutions
+            || self.breakpoints.contains(&(breakpoint as i32))
+            || self.guard_breakpoints.contains(&(breakpoint as i32))
+        {
             info!(
                 self.as_conf_object(),
                 "on_breakpoint_memop({:#x}, {}, {:#x})",
@@ -546,6 +700,12 @@ impl Tsffs {
                 self.add_processor(trigger_obj, false)?;
             }
 
+            if magic_number == MagicNumber::Guard {
+                // Declaring a guard region only sets breakpoints, which does not require
+                // stopping the simulation
+                return self.on_magic_guard(processor_number);
+            }
+
             let processor = self
                 .processors
                 .get_mut(&processor_number)
@@ -556,7 +716,8 @@ impl Tsffs {
             if match magic_number {
                 MagicNumber::StartBufferPtrSizePtr
                 | MagicNumber::StartBufferPtrSizeVal
-                | MagicNumber::StartBufferPtrSizePtrVal => {
+                | MagicNumber::StartBufferPtrSizePtrVal
+                | MagicNumber::StartRegisters => {
                     self.start_on_harness
                         && (if self.magic_start_index == index_selector {
                             // Set this processor as the start processor now that we know it is
@@ -577,6 +738,7 @@ impl Tsffs {
                 MagicNumber::StopAssert => {
                     self.stop_on_harness && self.magic_assert_indices.contains(&index_selector)
                 }
+                MagicNumber::Guard => false,
             } {
                 self.stop_simulation(StopReason::Magic { magic_number })?;
             } else {
@@ -2,18 +2,20 @@
 // SPDX-License-Identifier: Apache-2.0
 
 use crate::{
+    fuzzer::mutators::CustomPostProcessors,
     state::{SolutionKind, StopReason},
-    ManualStartAddress, ManualStartInfo, ManualStartSize, Tsffs,
+    HarnessCheckpointInfo, ManualStartAddress, ManualStartInfo, ManualStartSize, Tsffs,
 };
 use anyhow::{anyhow, Result};
 use libafl::inputs::HasBytesVec;
+use serde_json::from_str;
 use simics::{
-    continue_simulation, debug, interface, lookup_file, run_alone, AsConfObject, AttrValue,
-    ConfObject, GenericAddress,
+    continue_simulation, debug, get_object, interface, lookup_file, run_alone, AsConfObject,
+    AttrValue, ConfObject, GenericAddress,
 };
 use std::{
     ffi::{c_char, CStr},
-    fs::read,
+    fs::{read, read_to_string},
 };
 
 #[interface(name = "fuzz")]
@@ -25,6 +27,10 @@ impl Tsffs {
     ///
     /// This can be called during configuration *or* after stopping the fuzzer once a solution
     /// has been found.
+    ///
+    /// Corpus entries and solutions are saved before post-processing, so the post-processors
+    /// of any configured custom mutators are applied to the testcase file, the same way they
+    /// are applied to each testcase while fuzzing.
     pub fn repro(&mut self, testcase_file: *mut c_char) -> Result<()> {
         let simics_path = unsafe { CStr::from_ptr(testcase_file) }.to_str()?;
 
@@ -40,6 +46,16 @@ impl Tsffs {
             )
         })?;
 
+        let custom_mutator_libraries = self.custom_mutator_libraries()?;
+        let contents = CustomPostProcessors::new(&custom_mutator_libraries)
+            .apply(contents)
+            .ok_or_else(|| {
+                anyhow!(
+                    "Custom mutator post-processors discarded repro testcase file {}",
+                    testcase_file.display()
+                )
+            })?;
+
         self.repro_testcase = Some(contents);
 
         if self.iterations > 0 {
@@ -218,6 +234,47 @@ impl Tsffs {
         Ok(testcase.testcase.bytes().to_vec().try_into()?)
     }
 
+    /// Interface method to start the fuzzing loop from a checkpoint written by another fuzzer
+    /// instance when it reached the start harness (see `pre_snapshot_checkpoint`). The
+    /// checkpoint must already be loaded with `read-configuration`. This allows running
+    /// many instances without each of them booting the target to reach the harness.
+    ///
+    /// # Arguments
+    ///
+    /// * `checkpoint` - The path to the checkpoint directory which was loaded
+    pub fn start_from_checkpoint(&mut self, checkpoint: *mut c_char) -> Result<()> {
+        let simics_path = unsafe { CStr::from_ptr(checkpoint) }.to_str()?;
+
+        let checkpoint = lookup_file(simics_path)?;
+
+        debug!(
+            self.as_conf_object(),
+            "start_from_checkpoint({})",
+            checkpoint.display()
+        );
+
+        let info_file = checkpoint.join(Self::HARNESS_CHECKPOINT_INFO_FILE);
+
+        let info: HarnessCheckpointInfo = from_str(&read_to_string(&info_file).map_err(|e| {
+            anyhow!(
+                "Failed to read harness checkpoint information {}: {}",
+                info_file.display(),
+                e
+            )
+        })?)?;
+
+        // Interrupts were already quiesced in the checkpoint, so the state to restore when the
+        // fuzzer stops is the one saved before quiescing
+        self.interrupt_state = info.interrupt_state;
+
+        self.stop_simulation(StopReason::CheckpointStart {
+            processor: get_object(&info.processor)?,
+            info: info.start_info,
+        })?;
+
+        Ok(())
+    }
+
     /// Interface method to manually signal to stop a testcase execution. When this
     /// method is called, the current testcase execution will be stopped as if it had
     /// finished executing normally, and the state will be restored to the state at the
@@ -34,21 +34,31 @@ use crate::state::SolutionKind;
 use crate::util::Utils;
 use anyhow::{anyhow, Result};
 use arch::{Architecture, ArchitectureHint, ArchitectureOperations};
-use fuzzer::{messages::FuzzerMessage, ShutdownMessage, Testcase};
+use fuzzer::{
+    ensemble::EnsembleProfile, messages::FuzzerMessage, mutators::CustomMutatorLibrary,
+    observers::InputAccess, ShutdownMessage, Testcase,
+};
 use indoc::indoc;
 use libafl::{inputs::HasBytesVec, prelude::ExitKind};
-use libafl_bolts::prelude::OwnedMutSlice;
+use libafl_bolts::{hash_std, prelude::OwnedMutSlice};
 use libafl_targets::AFLppCmpLogMap;
+use log::timeline::Timeline;
 use magic::MagicNumber;
 use num_traits::FromPrimitive as _;
 use serde::{Deserialize, Serialize};
+#[cfg(any(
+    simics_experimental_api_snapshots,
+    simics_experimental_api_snapshots_v2,
+    simics_stable_api_snapshots
+))]
+use serde_json::{to_string, to_string_pretty};
 use simics::{
     break_simulation, class, error, free_attribute, get_class, get_interface, get_processor_number,
-    info, lookup_file, object_clock, run_command, run_python, simics_init, trace, AsConfObject,
-    BreakpointId, ClassCreate, ClassObjectsFinalize, ConfObject, CoreBreakpointMemopHap,
-    CoreExceptionHap, CoreMagicInstructionHap, CoreSimulationStoppedHap,
+    info, lookup_file, object_clock, run_command, run_python, simics_init, trace, warn,
+    AsConfObject, BreakpointId, ClassCreate, ClassObjectsFinalize, ConfObject,
+    CoreBreakpointMemopHap, CoreExceptionHap, CoreMagicInstructionHap, CoreSimulationStoppedHap,
     CpuInstrumentationSubscribeInterface, Event, EventClassFlag, FromConfObject, HapHandle,
-    Interface, IntoAttrValueDict,
+    Interface, IntoAttrValueDict, MemorySpaceInterface,
 };
 #[cfg(any(
     simics_experimental_api_snapshots,
@@ -59,31 +69,41 @@ use simics::{
 // which is necessary because this module is compatible with base versions which cross the
 // deprecation boundary
 use simics::{
-    debug, restore_snapshot, save_snapshot, sys::save_flags_t, write_configuration_to_file,
+    debug, object_name, restore_snapshot, save_snapshot, sys::save_flags_t,
+    write_configuration_to_file,
 };
 #[cfg(not(simics_deprecated_api_rev_exec))]
 use simics::{
     discard_future, restore_micro_checkpoint, save_micro_checkpoint, MicroCheckpointFlags,
 };
-use state::StopReason;
+use state::{
+    ProcessorState, SolutionState, StateDigest, StopReason, DRIFT_CHECK_PAGE_SIZE,
+    DRIFT_CHECK_READ_SIZE, SOLUTION_STATE_STACK_DEPTH,
+};
 #[cfg(any(
     simics_experimental_api_snapshots,
     simics_experimental_api_snapshots_v2,
     simics_stable_api_snapshots
 ))]
-use std::fs::remove_dir_all;
+use std::fs::{create_dir_all, remove_dir_all, write};
 use std::{
     alloc::{alloc_zeroed, Layout},
     cell::OnceCell,
-    collections::{hash_map::Entry, BTreeSet, HashMap, HashSet},
+    collections::{hash_map::Entry, BTreeMap, BTreeSet, HashMap, HashSet, VecDeque},
     fs::File,
     path::PathBuf,
     ptr::null_mut,
-    sync::mpsc::{Receiver, Sender},
+    sync::{
+        mpsc::{Receiver, Sender},
+        Arc, Mutex,
+    },
     thread::JoinHandle,
     time::SystemTime,
 };
-use tracer::tsffs::{on_instruction_after, on_instruction_before};
+use tracer::{
+    tsffs::{on_instruction_after, on_instruction_before},
+    CoverageMode,
+};
 use typed_builder::TypedBuilder;
 
 pub(crate) mod arch;
@@ -138,9 +158,11 @@ impl ManualStartAddress {
 
 #[derive(TypedBuilder, Serialize, Deserialize, Clone, Debug)]
 pub(crate) struct StartInfo {
+    #[builder(default, setter(strip_option))]
     /// The physical address of the buffer. Must be physical, if the input address was
-    /// virtual, it should be pre-translated
-    pub address: StartPhysicalAddress,
+    /// virtual, it should be pre-translated. There is no buffer if the harness takes its
+    /// input in `registers`
+    pub address: Option<StartPhysicalAddress>,
     /// The initial contents of the buffer
     pub contents: Vec<u8>,
     /// The initial size of the buffer. This will either be only an address, in which
@@ -149,6 +171,11 @@ pub(crate) struct StartInfo {
     /// not be written, or a `size_ptr` and `max_size` in which case the size will be
     /// written back to `*size_ptr` and the maximum size will be `max_size`.
     pub size: StartSize,
+    #[builder(default)]
+    #[serde(default)]
+    /// The registers each testcase is written to in order, one register-width chunk of the
+    /// testcase per register, if the harness takes its input in registers instead of a buffer
+    pub registers: Vec<String>,
 }
 
 #[derive(Serialize, Deserialize, Clone, Debug)]
@@ -189,6 +216,14 @@ impl StartSize {
             StartSize::SizePtrAndMaxSize { address, .. } => Some(address.clone()),
         }
     }
+
+    pub fn set_maximum_size(&mut self, size: usize) {
+        match self {
+            StartSize::SizePtr { maximum_size, .. } => *maximum_size = size,
+            StartSize::MaxSize(maximum_size) => *maximum_size = size,
+            StartSize::SizePtrAndMaxSize { maximum_size, .. } => *maximum_size = size,
+        }
+    }
 }
 
 #[derive(Serialize, Deserialize, Clone, Debug)]
@@ -203,6 +238,22 @@ pub(crate) enum ManualStartSize {
     },
 }
 
+#[derive(Serialize, Deserialize, Clone, Debug)]
+/// Information saved alongside the checkpoint written when the start harness is reached. This
+/// allows additional fuzzer instances to start fuzzing directly from the checkpoint instead of
+/// booting the target to reach the harness themselves.
+pub(crate) struct HarnessCheckpointInfo {
+    /// The name of the start processor object
+    pub processor: String,
+    /// The buffer and size information, if the harness provides a buffer
+    pub start_info: Option<StartInfo>,
+    #[serde(default)]
+    /// The interrupt state of the start processor before interrupts were quiesced, if they
+    /// were. The checkpoint is written after quiescing, so instances starting from it cannot
+    /// read the original state from the processor.
+    pub interrupt_state: Option<u64>,
+}
+
 #[class(name = "tsffs", skip_objects_finalize, attr_value)]
 #[derive(AsConfObject, FromConfObject, Default, IntoAttrValueDict)]
 /// The main module class for the TSFFS fuzzer, stores state and configuration information
@@ -247,6 +298,36 @@ pub(crate) struct Tsffs {
     /// $bp = (bp.memory.break -x $addr)
     /// @tsffs.breakpoints = [simenv.bp]
     pub breakpoints: BTreeSet<BreakpointId>,
+    #[class(attribute(optional))]
+    #[attr_value(fallible)]
+    /// Guard regions which the target must never write (or read, if `guard_reads` is set).
+    /// Each region is an `[address, length]` pair of a physical address and a length in
+    /// bytes, and any access to a region is treated as a breakpoint solution. For example:
+    ///
+    /// @tsffs.guard_regions = [[0x100000, 64], [0x100140, 64]]
+    ///
+    /// Regions can also be declared by the target with the `HARNESS_GUARD` harness.
+    pub guard_regions: Vec<Vec<u64>>,
+    #[class(attribute(optional, default = 0))]
+    /// The size in bytes of the guard region at the end of the testcase buffer. The maximum
+    /// testcase size is reduced by this many bytes, and the last bytes of the buffer are
+    /// guarded when the start harness is reached, so writes past the end of a testcase of
+    /// the maximum size are caught. Zero disables the guard region.
+    pub guard_testcase_buffer: u64,
+    #[class(attribute(optional, default = false))]
+    /// Whether reads of guard regions, and not only writes, are treated as solutions
+    pub guard_reads: bool,
+    #[class(attribute(optional, default = false))]
+    /// Whether to capture the state of the target when a solution occurs, before the initial
+    /// snapshot is restored. The registers, call stack and fault address of each traced
+    /// processor and the most recent edges taken are written as JSON to a hidden
+    /// `.<solution>.state.json` file next to each solution in the solutions directory, so
+    /// most solutions can be triaged without reproducing them.
+    pub capture_solution_state: bool,
+    #[class(attribute(optional, default = 64))]
+    /// The number of most recent edges kept for the state captured at each solution when
+    /// `capture_solution_state` is set
+    pub solution_state_edges: usize,
     #[class(attribute(optional, default = 5.0))]
     /// The timeout in seconds of virtual time for each iteration of the fuzzer. If the virtual
     /// time timeout is exceeded for a single iteration, the iteration is stopped and the testcase
@@ -309,6 +390,27 @@ pub(crate) struct Tsffs {
     /// run indefinitely. If set to a positive integer, the fuzzer will run until the limit is
     /// reached.
     pub iteration_limit: usize,
+    #[class(attribute(optional))]
+    /// The limit on the number of solutions to find. If set to 0, the fuzzer will run
+    /// indefinitely. If set to a positive integer, the fuzzer will stop once this many
+    /// solutions have been found.
+    pub solution_limit: usize,
+    #[class(attribute(optional, default = 0.0))]
+    /// The limit in seconds of host time to fuzz for, measured from the first iteration. If
+    /// set to 0, there is no limit.
+    pub time_limit: f64,
+    #[class(attribute(optional, default = 0.0))]
+    /// The limit in seconds of virtual time to fuzz for, summed over all iterations. If set to
+    /// 0, there is no limit.
+    pub virtual_time_limit: f64,
+    #[class(attribute(optional))]
+    /// The number of iterations without new coverage after which the fuzzer stops. If set to
+    /// 0, the fuzzer does not stop when coverage plateaus.
+    pub plateau_iterations: usize,
+    #[class(attribute(optional, default = 0.0))]
+    /// The number of seconds of host time without new coverage after which the fuzzer stops.
+    /// If set to 0, the fuzzer does not stop when coverage plateaus.
+    pub plateau_time: f64,
     #[class(attribute(optional, default = 8))]
     /// The size of the corpus to generate randomly. If `generate_random_corpus` is set to
     /// `True`, the fuzzer will generate a random corpus of this size before starting the
@@ -344,9 +446,57 @@ pub(crate) struct Tsffs {
     /// values.
     pub cmplog: bool,
     #[class(attribute(optional, default = true))]
+    /// Whether comparison logging should skip compare sites whose branch has already been
+    /// observed going both ways. Once both outcomes of a comparison are covered, logging its
+    /// operands no longer helps the fuzzer, so skipping it reduces the cost of each comparison
+    /// logging execution.
+    pub cmplog_skip_solved_sites: bool,
+    #[class(attribute(optional, default = false))]
+    /// Whether comparison logging stages should only run while coverage is stagnant. When
+    /// set along with `cmplog`, the comparison logging stages start disabled and are enabled
+    /// once fewer than `cmplog_adaptive_threshold` new corpus entries per thousand executions
+    /// are found over a window of `cmplog_adaptive_window` executions. They are disabled
+    /// again, with an increasing delay before they are retried, when a window with them
+    /// enabled also stays below the threshold.
+    pub cmplog_adaptive: bool,
+    #[class(attribute(optional, default = 1.0))]
+    /// The rate of new corpus entries per thousand executions below which coverage is
+    /// considered stagnant when `cmplog_adaptive` is set
+    pub cmplog_adaptive_threshold: f64,
+    #[class(attribute(optional, default = 10000))]
+    /// The number of executions over which the rate of new corpus entries is measured when
+    /// `cmplog_adaptive` is set
+    pub cmplog_adaptive_window: usize,
+    #[class(attribute(optional, default = true))]
     /// Whether coverage reporting should be enabled. When enabled, new edge addresses will
     /// be logged.
     pub coverage_reporting: bool,
+    #[class(attribute(optional, default = false))]
+    /// Whether edges should be identified by the physical address of their target instead of
+    /// its logical address. Identical logical addresses in different address spaces then no
+    /// longer collide, at the same cost of one interface call per edge. Edge addresses in the
+    /// log are physical when this is set.
+    pub coverage_physical_addresses: bool,
+    #[class(attribute(optional, default = false))]
+    /// Whether the tracer should store AFL hit count buckets in the coverage map as edges are
+    /// hit, instead of raw hit counts which are classified into buckets after each iteration.
+    /// This replaces the classification pass over the whole coverage map after each iteration
+    /// with a table lookup per edge. The map is still reset before each execution by the
+    /// fuzzer's edges observer, so only the classification pass is saved.
+    pub classify_coverage_at_trace: bool,
+    #[class(attribute(optional, default = false))]
+    /// Whether direct unconditional jumps and calls should be traced as edges. The target of
+    /// a direct unconditional jump or call is determined by the instruction alone, so the
+    /// edge adds no information to the coverage map beyond the preceding edge. By default
+    /// only conditional and indirect control flow (including returns) is traced.
+    pub trace_direct_branches: bool,
+    #[class(attribute(optional, default = false))]
+    /// Whether coverage should be collected with the built-in SIMICS branch recorder instead
+    /// of by decoding every executed instruction in an instrumentation callback. If set to
+    /// `True`, a branch recorder is attached to each traced processor and the branch arcs it
+    /// records are hashed into the coverage map when each iteration stops. Comparison logging
+    /// is unaffected by this option.
+    pub use_branch_recorder: bool,
     #[class(attribute(optional))]
     #[attr_value(fallible)]
     /// A set of executable files to tokenize. Tokens will be extracted from these files and
@@ -356,7 +506,8 @@ pub(crate) struct Tsffs {
     #[attr_value(fallible)]
     /// A set of source files to tokenize. Tokens will be extracted from these files and used
     /// to drive token mutations of testcases. C source files are expected, and strings and
-    /// tokens will be extracted from strings in the source files.
+    /// tokens will be extracted from strings in the source files. Integer constants and enum
+    /// values are also extracted into a separate dictionary of integer tokens.
     pub token_src_files: Vec<PathBuf>,
     #[class(attribute(optional))]
     #[attr_value(fallible)]
@@ -369,6 +520,36 @@ pub(crate) struct Tsffs {
     pub token_files: Vec<PathBuf>,
     #[class(attribute(optional))]
     #[attr_value(fallible)]
+    /// Native shared libraries implementing the AFL++ custom mutator API. Each library must
+    /// export `afl_custom_init`, and may export `afl_custom_fuzz` to provide a mutator and
+    /// `afl_custom_post_process` to transform each testcase before it is written to the target
+    /// (for example to fix up a checksum).
+    pub custom_mutators: Vec<PathBuf>,
+    #[class(attribute(optional, default = 0))]
+    /// The number of remote executors to create channels for. When nonzero, the fuzzer
+    /// creates one shared memory channel per remote executor and writes their identifiers to
+    /// `remote_executor_channels_path`. Other simulator instances with one of the identifiers
+    /// set as their `remote_fuzzer_channel` then run inputs mutated by this fuzzer, which owns
+    /// the only corpus, scheduler and feedback state.
+    pub remote_executors: usize,
+    #[class(attribute(optional, default = lookup_file("%simics%")?.join("remote-executors.json")))]
+    #[attr_value(fallible)]
+    /// The path the identifiers of the remote executor channels are written to as a JSON list
+    pub remote_executor_channels_path: PathBuf,
+    #[class(attribute(optional))]
+    /// The identifier of a channel created by a central fuzzer. When set, this instance runs
+    /// no fuzzer of its own, and instead runs the inputs it receives on the channel and
+    /// returns their exit kinds and coverage to the central fuzzer.
+    pub remote_fuzzer_channel: String,
+    #[class(attribute(optional, default = -1))]
+    /// The index of this instance among instances fuzzing the same target with a shared corpus.
+    /// When set to a non-negative value, the instance overrides `cmplog` and its power
+    /// schedule, coverage mode, and maximum testcase size with a profile chosen by its
+    /// index, so instances explore the corpus with different strategies, and reports the
+    /// yield of its profile in the log.
+    pub ensemble_instance: i64,
+    #[class(attribute(optional))]
+    #[attr_value(fallible)]
     /// Sets of tokens to use to drive token mutations of testcases. Each token set is a
     /// bytes which will be randomically inserted into testcases.
     pub tokens: Vec<Vec<u8>>,
@@ -385,8 +566,64 @@ pub(crate) struct Tsffs {
     #[class(attribute(optional, default = true))]
     pub log_to_file: bool,
     #[class(attribute(optional, default = false))]
+    /// Whether to export a timeline of the work done by the simulator and fuzzer threads to
+    /// `timeline_path` in the Chrome trace event format, which can be opened in Perfetto. The
+    /// timeline shows where each thread waits on the other.
+    pub export_timeline: bool,
+    #[class(attribute(optional, default = lookup_file("%simics%")?.join("timeline.json")))]
+    #[attr_value(fallible)]
+    /// The path to the timeline file written when `export_timeline` is set
+    pub timeline_path: PathBuf,
+    #[class(attribute(optional, default = 60.0))]
+    /// The number of seconds from the start of the campaign to record in the timeline, so the
+    /// timeline file does not grow without bound. If zero, the whole campaign is recorded.
+    pub timeline_duration: f64,
+    #[class(attribute(optional, default = false))]
     pub keep_all_corpus: bool,
     #[class(attribute(optional, default = false))]
+    /// Whether to mask interrupts on the start processor while fuzzing. When set, maskable
+    /// interrupts are disabled on the start processor before the initial snapshot is taken,
+    /// so timer and device interrupt handlers do not run inside fuzzing iterations. The
+    /// original interrupt state is restored when stopping for repro.
+    pub quiesce_interrupts: bool,
+    #[class(attribute(optional))]
+    #[attr_value(fallible)]
+    /// The processor privilege levels at which instructions are traced. When empty, all
+    /// privilege levels are traced. For example, setting:
+    ///
+    /// @tsffs.trace_privilege_levels = [3]
+    ///
+    /// on x86_64 would only trace user-space instructions.
+    pub trace_privilege_levels: BTreeSet<i64>,
+    #[class(attribute(optional, default = false))]
+    /// Whether to only trace instructions executed in the address space which is active on the
+    /// start processor when the start harness is reached, identified by the page table base
+    /// held in `CR3` on x86 and `satp` on RISC-V. Instructions from other processes are neither
+    /// traced nor recorded in the coverage map.
+    pub trace_start_address_space: bool,
+    #[class(attribute(optional, default = false))]
+    /// Whether to track which bytes of the testcase buffer the target reads. When set, a read
+    /// breakpoint is set on the testcase buffer, and each testcase added to the corpus is
+    /// saved with metadata containing the length of the testcase consumed by the target and a
+    /// bitmap of the bytes it read.
+    pub track_input_access: bool,
+    #[class(attribute(optional, default = false))]
+    /// Whether to verify that restoring the initial snapshot reproduces the state it was saved
+    /// with. When set, the integer registers of each traced processor and each page in
+    /// `drift_check_pages` are hashed when the snapshot is saved, and the registers and a
+    /// sample of the pages are hashed again and compared after each restore. Drift is
+    /// reported as a warning.
+    pub verify_snapshot_restore: bool,
+    #[class(attribute(optional))]
+    /// Physical addresses of the memory pages to hash when `verify_snapshot_restore` is set.
+    /// Addresses are rounded down to the start of their page.
+    pub drift_check_pages: Vec<u64>,
+    #[class(attribute(optional, default = 8))]
+    /// The number of pages from `drift_check_pages` compared after each restore when
+    /// `verify_snapshot_restore` is set. Pages are sampled in turn, so every page is checked
+    /// once every `len(drift_check_pages) / drift_check_sample_pages` restores.
+    pub drift_check_sample_pages: usize,
+    #[class(attribute(optional, default = false))]
     /// Whether to use the initial contents of the testcase buffer as an entry in the corpus
     pub use_initial_as_corpus: bool,
     #[class(attribute(optional, default = false))]
@@ -449,6 +686,16 @@ pub(crate) struct Tsffs {
     /// The previous location for coverage for calculating the hash of edges.
     coverage_prev_loc: u64,
     #[attr_value(skip)]
+    /// The branch recorder attached to traced processors when `use_branch_recorder` is set
+    branch_recorder: OnceCell<*mut ConfObject>,
+    #[attr_value(skip)]
+    /// The testcase bytes read by the target during the current iteration, shared with the
+    /// fuzzer thread
+    input_access: Arc<Mutex<InputAccess>>,
+    #[attr_value(skip)]
+    /// The read breakpoint on the testcase buffer when `track_input_access` is set
+    input_access_breakpoint: Option<BreakpointId>,
+    #[attr_value(skip)]
     /// The registered timeout event which is registered and used to detect timeouts in
     /// virtual time
     timeout_event: OnceCell<Event>,
@@ -459,6 +706,57 @@ pub(crate) struct Tsffs {
     /// A map of the new edges to their AFL indices seen since the last time the fuzzer
     /// provided an update
     edges_seen_since_last: HashMap<u64, u64>,
+    #[attr_value(skip)]
+    /// The ensemble profile this instance uses, if `ensemble_instance` is set
+    ensemble_profile: Option<EnsembleProfile>,
+    #[attr_value(skip)]
+    /// How edge hits are recorded in the coverage map
+    coverage_mode: CoverageMode,
+    #[attr_value(skip)]
+    /// The number of corpus entries this instance has found since fuzzing started, not
+    /// counting entries synchronized from other instances
+    corpus_entries_found: usize,
+    #[attr_value(skip)]
+    /// The breakpoints set on guard regions
+    guard_breakpoints: BTreeSet<BreakpointId>,
+    #[attr_value(skip)]
+    /// The physical address and length of each guarded region
+    guarded_regions: BTreeSet<(u64, u64)>,
+    #[attr_value(skip)]
+    /// The breakpoints of each guarded region declared by a guard harness during the current
+    /// iteration, which are removed when the initial snapshot is restored
+    iteration_guards: BTreeMap<(u64, u64), Vec<BreakpointId>>,
+    #[attr_value(skip)]
+    /// The timeline spans are recorded to, when `export_timeline` is set
+    timeline: Option<Timeline>,
+    #[attr_value(skip)]
+    /// The time the simulation was last resumed, which starts the span of the next run
+    run_span_start: Option<u64>,
+    #[attr_value(skip)]
+    /// The raw hit count of each coverage map entry in the current iteration, when
+    /// `classify_coverage_at_trace` is set
+    hit_counts: Vec<u8>,
+    #[attr_value(skip)]
+    /// The coverage map entries with non-zero counts in `hit_counts`
+    hit_count_indices: Vec<usize>,
+    #[attr_value(skip)]
+    /// Processors whose last traced instruction was a control flow instruction, whose target
+    /// is logged at the next instruction when `coverage_physical_addresses` is set
+    pending_physical_edges: HashSet<i32>,
+    #[attr_value(skip)]
+    /// The compare site traced at the previous instruction, if that instruction was not
+    /// itself a conditional branch
+    last_cmp_site: Option<u64>,
+    #[attr_value(skip)]
+    /// The compare site whose conditional branch is executing, credited with the next edge
+    pending_cmp_site: Option<u64>,
+    #[attr_value(skip)]
+    /// The first branch outcome observed for each compare site which has only been seen
+    /// resolving one way
+    cmp_site_outcomes: HashMap<u64, u64>,
+    #[attr_value(skip)]
+    /// Compare sites which have been observed resolving both ways, and are no longer logged
+    solved_cmp_sites: HashSet<u64>,
 
     #[attr_value(skip)]
     /// The name of the fuzz snapshot, if saved
@@ -474,6 +772,47 @@ pub(crate) struct Tsffs {
     #[attr_value(skip)]
     /// The buffer and size information, if saved
     start_info: OnceCell<StartInfo>,
+    #[attr_value(skip)]
+    /// Whether fuzzing was started from a harness checkpoint written by another instance
+    started_from_checkpoint: bool,
+    #[attr_value(skip)]
+    /// The value of the start processor's interrupt enable register before interrupts were
+    /// masked, if `quiesce_interrupts` is set
+    interrupt_state: Option<u64>,
+    #[attr_value(skip)]
+    /// The address space captured at the start harness when `trace_start_address_space` is set
+    trace_address_space: Option<u64>,
+    #[attr_value(skip)]
+    /// The number of the address space register of each traced processor, by processor number
+    address_space_registers: HashMap<i32, i32>,
+    #[attr_value(skip)]
+    /// Whether the instruction each processor is executing is in the scope traced under the
+    /// privilege level and address space filters, by processor number
+    trace_scope: HashMap<i32, bool>,
+    #[attr_value(skip)]
+    /// Digests of the state recorded when the initial snapshot was saved, if
+    /// `verify_snapshot_restore` is set
+    snapshot_digest: Option<StateDigest>,
+    #[attr_value(skip)]
+    /// The targets of the most recent edges taken in the current iteration, when
+    /// `capture_solution_state` is set
+    recent_edges: VecDeque<u64>,
+    #[attr_value(skip)]
+    /// The name the corpora give the testcase of the current iteration, when
+    /// `capture_solution_state` is set
+    current_testcase_name: Option<String>,
+    #[attr_value(skip)]
+    /// The libraries in `custom_mutators`, once loaded
+    custom_mutator_libraries: Option<Vec<Arc<CustomMutatorLibrary>>>,
+    #[attr_value(skip)]
+    /// The exception which stopped the current iteration as a solution
+    solution_exception: Option<i64>,
+    #[attr_value(skip)]
+    /// The index in the recorded page digests of the next page to check for drift
+    drift_check_cursor: usize,
+    #[attr_value(skip)]
+    /// The number of restores after which drift from the snapshot state was detected
+    snapshot_drift_count: usize,
 
     #[attr_value(skip)]
     // #[builder(default = SystemTime::now())]
@@ -508,6 +847,22 @@ pub(crate) struct Tsffs {
     #[attr_value(skip)]
     /// The number of iterations which have been executed so far
     iterations: usize,
+    #[attr_value(skip)]
+    /// The number of solutions which have been found so far
+    solutions: usize,
+    #[attr_value(skip)]
+    /// The iteration count when new coverage was last reported by the fuzzer
+    last_new_coverage_iteration: usize,
+    #[attr_value(skip)]
+    /// The time new coverage was last reported by the fuzzer
+    last_new_coverage_time: Option<SystemTime>,
+    #[attr_value(skip)]
+    /// The virtual time of the start processor when the current iteration started
+    iteration_start_virtual_time: f64,
+    #[attr_value(skip)]
+    /// The virtual time spent in all iterations so far. Only tracked if `virtual_time_limit`
+    /// is set
+    virtual_time_elapsed: f64,
 }
 
 impl ClassObjectsFinalize for Tsffs {
@@ -599,17 +954,20 @@ impl Tsffs {
     pub const TIMEOUT_EVENT_NAME: &'static str = "detector_timeout_event";
     /// The name of the initial snapshot
     pub const SNAPSHOT_NAME: &'static str = "tsffs-origin-snapshot";
+    /// The name of the file in the checkpoint directory the harness checkpoint information is
+    /// saved to
+    pub const HARNESS_CHECKPOINT_INFO_FILE: &'static str = "tsffs-harness.json";
 }
 
 /// Implementations for controlling the simulation
 impl Tsffs {
     /// Stop the simulation with a reason
     pub fn stop_simulation(&mut self, reason: StopReason) -> Result<()> {
-        let break_string = reason.to_string();
+        let code = reason.code();
 
         self.stop_reason = Some(reason);
 
-        break_simulation(break_string)?;
+        break_simulation(code)?;
 
         Ok(())
     }
@@ -636,11 +994,15 @@ impl Tsffs {
             };
             e.insert(architecture);
             let mut cpu_interface: CpuInstrumentationSubscribeInterface = get_interface(cpu)?;
-            cpu_interface.register_instruction_after_cb(
-                null_mut(),
-                Some(on_instruction_after),
-                self as *mut Self as *mut _,
-            )?;
+            if self.use_branch_recorder {
+                self.attach_branch_recorder(cpu)?;
+            } else {
+                cpu_interface.register_instruction_after_cb(
+                    null_mut(),
+                    Some(on_instruction_after),
+                    self as *mut Self as *mut _,
+                )?;
+            }
             cpu_interface.register_instruction_before_cb(
                 null_mut(),
                 Some(on_instruction_before),
@@ -664,6 +1026,31 @@ impl Tsffs {
             .get()
             .and_then(|n| self.processors.get_mut(n))
     }
+
+    /// Mask interrupts on the start processor if `quiesce_interrupts` is set, saving the
+    /// previous interrupt state so it can be restored
+    pub fn quiesce_interrupts_if_needed(&mut self) -> Result<()> {
+        if self.quiesce_interrupts && self.interrupt_state.is_none() {
+            let state = self
+                .start_processor()
+                .ok_or_else(|| anyhow!("No start processor"))?
+                .mask_interrupts()?;
+            self.interrupt_state = Some(state);
+        }
+
+        Ok(())
+    }
+
+    /// Restore the interrupt state of the start processor if interrupts were masked
+    pub fn restore_interrupts_if_needed(&mut self) -> Result<()> {
+        if let Some(state) = self.interrupt_state.take() {
+            self.start_processor()
+                .ok_or_else(|| anyhow!("No start processor"))?
+                .restore_interrupts(state)?;
+        }
+
+        Ok(())
+    }
 }
 
 impl Tsffs {
@@ -677,7 +1064,9 @@ impl Tsffs {
                 simics_stable_api_snapshots
             ))]
             {
-                if self.checkpoint_path.exists() {
+                // An instance started from a harness checkpoint must not remove or overwrite
+                // the checkpoint, which other instances may be starting from
+                if !self.started_from_checkpoint && self.checkpoint_path.exists() {
                     remove_dir_all(&self.checkpoint_path)?;
                 }
 
@@ -687,8 +1076,9 @@ impl Tsffs {
                     self.checkpoint_path.display()
                 );
 
-                if self.pre_snapshot_checkpoint {
+                if self.pre_snapshot_checkpoint && !self.started_from_checkpoint {
                     write_configuration_to_file(&self.checkpoint_path, save_flags_t(0))?;
+                    self.write_harness_checkpoint_info()?;
                 }
 
                 save_snapshot(Self::SNAPSHOT_NAME)?;
@@ -733,12 +1123,58 @@ impl Tsffs {
             panic!("Micro checkpoints are deprecated in SIMICS >=7.0.0 and cannot be used. Set `use_snapshots` to `true` to use snapshots instead.");
         }
 
+        self.record_snapshot_digest_if_needed()?;
+
+        Ok(())
+    }
+
+    #[cfg(any(
+        simics_experimental_api_snapshots,
+        simics_experimental_api_snapshots_v2,
+        simics_stable_api_snapshots
+    ))]
+    /// Write the start processor and buffer information into the checkpoint directory, so
+    /// other instances can start fuzzing from the checkpoint with `start_from_checkpoint`
+    fn write_harness_checkpoint_info(&mut self) -> Result<()> {
+        let processor = object_name(
+            self.start_processor()
+                .ok_or_else(|| anyhow!("No start processor"))?
+                .cpu(),
+        )?;
+
+        let info = HarnessCheckpointInfo {
+            processor,
+            start_info: self.start_info.get().cloned(),
+            interrupt_state: self.interrupt_state,
+        };
+
+        write(
+            self.checkpoint_path
+                .join(Self::HARNESS_CHECKPOINT_INFO_FILE),
+            to_string(&info)?,
+        )?;
+
         Ok(())
     }
 
     /// Restore the initial snapshot using the configured method (either rev-exec micro checkpoints
-    /// or snapshots)
+    /// or snapshots), verifying the restored state if `verify_snapshot_restore` is set
     pub fn restore_initial_snapshot(&mut self) -> Result<()> {
+        let span = self.span_start();
+
+        self.restore_full_snapshot()?;
+
+        self.record_span("restore", span);
+
+        if self.verify_snapshot_restore {
+            self.check_snapshot_drift()?;
+        }
+
+        Ok(())
+    }
+
+    /// Restore the complete initial snapshot using the configured method
+    fn restore_full_snapshot(&mut self) -> Result<()> {
         if self.use_snapshots {
             #[cfg(any(
                 simics_experimental_api_snapshots,
@@ -768,6 +1204,127 @@ impl Tsffs {
         Ok(())
     }
 
+    /// Hash the page at physical address `page` as seen by the start processor. The page is
+    /// read with a few inquiry reads of the processor's physical memory space, instead of one
+    /// `read_phys_memory` call per 8 bytes, which would cost more than hashing the page.
+    fn page_digest(&mut self, page: u64) -> Result<u64> {
+        let physical_memory = self
+            .start_processor()
+            .ok_or_else(|| anyhow!("No start processor"))?
+            .processor_info_v2()
+            .get_physical_memory()?;
+        let mut memory_space: MemorySpaceInterface = get_interface(physical_memory)?;
+        let mut contents = Vec::with_capacity(DRIFT_CHECK_PAGE_SIZE as usize);
+
+        for offset in (0..DRIFT_CHECK_PAGE_SIZE).step_by(DRIFT_CHECK_READ_SIZE) {
+            let value =
+                memory_space.read(null_mut(), page + offset, DRIFT_CHECK_READ_SIZE as i32, 1)?;
+            let data = (value.size() as usize == DRIFT_CHECK_READ_SIZE)
+                .then(|| value.as_data::<[u8; DRIFT_CHECK_READ_SIZE]>())
+                .flatten();
+
+            free_attribute(value)?;
+
+            contents.extend(
+                data.ok_or_else(|| anyhow!("Failed to read memory at {:#x}", page + offset))?,
+            );
+        }
+
+        Ok(hash_std(&contents))
+    }
+
+    /// Hash the integer registers of a traced processor
+    fn register_digest(processor: &mut Architecture) -> Result<u64> {
+        let values = processor
+            .register_values()?
+            .iter()
+            .flat_map(|v| v.to_le_bytes())
+            .collect::<Vec<_>>();
+
+        Ok(hash_std(&values))
+    }
+
+    /// Record digests of the registers of the traced processors and of every page in
+    /// `drift_check_pages` if `verify_snapshot_restore` is set. Called when the initial
+    /// snapshot is saved.
+    pub fn record_snapshot_digest_if_needed(&mut self) -> Result<()> {
+        if !self.verify_snapshot_restore || self.snapshot_digest.is_some() {
+            return Ok(());
+        }
+
+        let registers = self
+            .processors
+            .iter_mut()
+            .map(|(number, processor)| Ok((*number, Self::register_digest(processor)?)))
+            .collect::<Result<BTreeMap<_, _>>>()?;
+
+        let pages = self
+            .drift_check_pages
+            .clone()
+            .into_iter()
+            .map(|address| {
+                let page = address & !(DRIFT_CHECK_PAGE_SIZE - 1);
+                Ok((page, self.page_digest(page)?))
+            })
+            .collect::<Result<BTreeMap<_, _>>>()?;
+
+        self.snapshot_digest = Some(StateDigest { registers, pages });
+
+        Ok(())
+    }
+
+    /// Compare the registers of the traced processors and the next sample of pages against
+    /// the digests recorded when the initial snapshot was saved, returning whether the
+    /// restored state drifted from the snapshot state
+    pub fn check_snapshot_drift(&mut self) -> Result<bool> {
+        let Some(digest) = self.snapshot_digest.take() else {
+            return Ok(false);
+        };
+
+        let mut drifted = Vec::new();
+
+        for (number, expected) in digest.registers.iter() {
+            if let Some(processor) = self.processors.get_mut(number) {
+                if Self::register_digest(processor)? != *expected {
+                    drifted.push(format!("registers of processor {number}"));
+                }
+            }
+        }
+
+        let pages = digest.pages.iter().collect::<Vec<_>>();
+
+        if !pages.is_empty() {
+            let sample = self.drift_check_sample_pages.min(pages.len());
+
+            for i in 0..sample {
+                let (page, expected) = pages[(self.drift_check_cursor + i) % pages.len()];
+
+                if self.page_digest(*page)? != *expected {
+                    drifted.push(format!("page {page:#x}"));
+                }
+            }
+
+            self.drift_check_cursor = (self.drift_check_cursor + sample) % pages.len();
+        }
+
+        self.snapshot_digest = Some(digest);
+
+        if drifted.is_empty() {
+            return Ok(false);
+        }
+
+        self.snapshot_drift_count += 1;
+
+        warn!(
+            self.as_conf_object(),
+            "State drifted from the initial snapshot after restore {} times (this restore: {})",
+            self.snapshot_drift_count,
+            drifted.join(", ")
+        );
+
+        Ok(true)
+    }
+
     /// Whether an initial snapshot has been saved
     pub fn have_initial_snapshot(&self) -> bool {
         (self.snapshot_name.get().is_some() && self.use_snapshots)
@@ -799,12 +1356,78 @@ impl Tsffs {
             .ok_or_else(|| anyhow!("No start info"))?
             .clone();
 
+        let span = self.span_start();
+
         let start_processor = self
             .start_processor()
             .ok_or_else(|| anyhow!("No start processor"))?;
 
         start_processor.write_start(testcase.testcase.bytes(), &start_info)?;
 
+        self.record_span("write testcase", span);
+
+        if self.capture_solution_state {
+            self.current_testcase_name = Some(testcase.name);
+        }
+
+        Ok(())
+    }
+
+    /// Capture the state of the target for the solution in the current iteration and write it
+    /// next to the solution, if `capture_solution_state` is set. The state file is named
+    /// after the solution's file, which the solutions corpus names after its input before
+    /// post-processing.
+    pub fn capture_solution_state_if_needed(&mut self, kind: SolutionKind) -> Result<()> {
+        if !self.capture_solution_state {
+            return Ok(());
+        }
+
+        let name = self
+            .current_testcase_name
+            .clone()
+            .ok_or_else(|| anyhow!("No testcase for the current iteration"))?;
+
+        let exception = self.solution_exception.take();
+
+        let processors = self
+            .processors
+            .iter_mut()
+            .map(|(number, processor)| {
+                Ok((
+                    *number,
+                    ProcessorState {
+                        registers: processor.named_register_values()?,
+                        call_stack: processor.call_stack(SOLUTION_STATE_STACK_DEPTH)?,
+                        fault_address: match exception {
+                            Some(exception) if matches!(kind, SolutionKind::Exception) => {
+                                processor.fault_address(exception)?
+                            }
+                            _ => None,
+                        },
+                    },
+                ))
+            })
+            .collect::<Result<BTreeMap<_, _>>>()?;
+
+        let state = SolutionState {
+            kind,
+            exception,
+            iteration: self.iterations,
+            processors,
+            recent_edges: self.recent_edges.iter().copied().collect(),
+        };
+
+        let path = self.solutions_directory.join(format!(".{name}.state.json"));
+
+        create_dir_all(&self.solutions_directory)?;
+        write(&path, to_string_pretty(&state)?)?;
+
+        debug!(
+            self.as_conf_object(),
+            "Wrote solution state to {}",
+            path.display()
+        );
+
         Ok(())
     }
 
@@ -818,6 +1441,7 @@ impl Tsffs {
         let start_processor_time = start_processor.cycle().get_time()?;
         let start_processor_cpu = start_processor.cpu();
         let start_processor_clock = object_clock(start_processor_cpu)?;
+        self.iteration_start_virtual_time = start_processor_time;
         let timeout_time = self.timeout + start_processor_time;
         trace!(
             self.as_conf_object(),
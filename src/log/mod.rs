@@ -3,11 +3,17 @@
 
 //! Logging
 
-use crate::{fuzzer::messages::FuzzerMessage, Tsffs};
+use crate::{
+    fuzzer::{adaptive::ModeYield, messages::FuzzerMessage},
+    Tsffs,
+};
 use anyhow::{anyhow, Result};
 use serde::Serialize;
 use simics::{info, AsConfObject};
-use std::{fs::OpenOptions, io::Write};
+use std::{fs::OpenOptions, io::Write, time::SystemTime};
+use timeline::{Timeline, TimelineThread};
+
+pub mod timeline;
 
 #[derive(Clone, Debug, Serialize)]
 pub(crate) struct LogMessageEdge {
@@ -22,10 +28,41 @@ pub(crate) struct LogMessageInteresting {
     pub edges: Vec<LogMessageEdge>,
 }
 
+#[derive(Clone, Debug, Serialize)]
+pub(crate) struct LogMessageEnsembleYield {
+    pub instance: usize,
+    pub profile: String,
+    pub corpus_entries_found: usize,
+    pub iterations: usize,
+    pub elapsed_seconds: f64,
+    pub corpus_entries_found_per_hour: f64,
+}
+
+#[derive(Clone, Debug, Serialize)]
+pub(crate) struct LogMessageCmplogYield {
+    pub enabled: bool,
+    pub without_cmplog: ModeYield,
+    pub with_cmplog: ModeYield,
+    pub iterations: usize,
+}
+
+#[derive(Clone, Debug, Serialize)]
+pub(crate) struct LogMessageStopped {
+    pub reason: String,
+    pub iterations: usize,
+    pub solutions: usize,
+    pub edges: usize,
+    pub elapsed_seconds: f64,
+    pub virtual_seconds: f64,
+}
+
 #[derive(Clone, Debug, Serialize)]
 pub(crate) enum LogMessage {
     Message(String),
     Interesting(LogMessageInteresting),
+    EnsembleYield(LogMessageEnsembleYield),
+    CmplogYield(LogMessageCmplogYield),
+    Stopped(LogMessageStopped),
 }
 
 impl Tsffs {
@@ -43,6 +80,9 @@ impl Tsffs {
                     self.log(LogMessage::Message(s.clone()))?;
                 }
                 FuzzerMessage::Interesting { indices, input } => {
+                    self.last_new_coverage_iteration = self.iterations;
+                    self.last_new_coverage_time = Some(SystemTime::now());
+
                     info!(
                         self.as_conf_object(),
                         "Interesting input for AFL indices {indices:?} with input {input:?}"
@@ -75,6 +115,31 @@ impl Tsffs {
                         self.edges_seen_since_last.clear();
                     }
                 }
+                FuzzerMessage::CorpusEntriesFound(found) => {
+                    self.corpus_entries_found += found;
+                    self.log_ensemble_yield()?;
+                }
+                FuzzerMessage::CmplogYield {
+                    enabled,
+                    without_cmplog,
+                    with_cmplog,
+                } => {
+                    info!(
+                        self.as_conf_object(),
+                        "Comparison logging {}: {:.3} corpus entries per 1000 executions without \
+                        it, {:.3} with it",
+                        if *enabled { "enabled" } else { "disabled" },
+                        without_cmplog.per_thousand_executions(),
+                        with_cmplog.per_thousand_executions()
+                    );
+
+                    self.log(LogMessage::CmplogYield(LogMessageCmplogYield {
+                        enabled: *enabled,
+                        without_cmplog: *without_cmplog,
+                        with_cmplog: *with_cmplog,
+                        iterations: self.iterations,
+                    }))?;
+                }
             }
 
             Ok::<(), anyhow::Error>(())
@@ -83,6 +148,60 @@ impl Tsffs {
         Ok(())
     }
 
+    /// Report the number of corpus entries found by this instance's ensemble profile and the
+    /// rate they were found at, so profiles can be compared across instances
+    fn log_ensemble_yield(&mut self) -> Result<()> {
+        let (Some(profile), Ok(instance)) = (
+            self.ensemble_profile,
+            usize::try_from(self.ensemble_instance),
+        ) else {
+            return Ok(());
+        };
+
+        let elapsed_seconds = self
+            .start_time
+            .get()
+            .and_then(|t| t.elapsed().ok())
+            .map(|d| d.as_secs_f64())
+            .unwrap_or_default();
+        let corpus_entries_found_per_hour = if elapsed_seconds > 0.0 {
+            self.corpus_entries_found as f64 * 3600.0 / elapsed_seconds
+        } else {
+            0.0
+        };
+
+        info!(
+            self.as_conf_object(),
+            "Ensemble profile '{}' found {} corpus entries in {:.0}s ({:.2} per hour)",
+            profile.name,
+            self.corpus_entries_found,
+            elapsed_seconds,
+            corpus_entries_found_per_hour
+        );
+
+        self.log(LogMessage::EnsembleYield(LogMessageEnsembleYield {
+            instance,
+            profile: profile.name.to_string(),
+            corpus_entries_found: self.corpus_entries_found,
+            iterations: self.iterations,
+            elapsed_seconds,
+            corpus_entries_found_per_hour,
+        }))
+    }
+
+    /// The start time of a span on the simulator thread, if `export_timeline` is set
+    pub fn span_start(&self) -> Option<u64> {
+        self.timeline.as_ref().map(Timeline::now)
+    }
+
+    /// Record a span on the simulator thread from `start`, as returned by `span_start`,
+    /// until now
+    pub fn record_span(&self, name: &'static str, start: Option<u64>) {
+        if let (Some(timeline), Some(start)) = (self.timeline.as_ref(), start) {
+            timeline.record(name, TimelineThread::Simulator, start);
+        }
+    }
+
     pub fn log<I>(&mut self, item: I) -> Result<()>
     where
         I: Serialize,
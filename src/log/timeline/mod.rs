@@ -0,0 +1,358 @@
+// Copyright (C) 2024 Intel Corporation
+// SPDX-License-Identifier: Apache-2.0
+
+//! Timeline of the spans of work done by the simulator and fuzzer threads, exported in the
+//! Chrome trace event format which can be opened in Perfetto or `chrome://tracing`
+//!
+//! Spans are sent over a bounded channel to a writer thread, so recording a span never
+//! blocks on the file. When the channel is full, spans are dropped and the number dropped is
+//! recorded in the timeline instead. Only the first part of a campaign is recorded, so the
+//! file does not grow without bound.
+
+use anyhow::{anyhow, Result};
+use libafl::{
+    stages::Stage,
+    state::{State, UsesState},
+};
+use serde::Serialize;
+use serde_json::to_writer;
+use std::{
+    fs::File,
+    io::{BufWriter, Write},
+    path::Path,
+    sync::{
+        atomic::{AtomicU64, Ordering},
+        mpsc::{sync_channel, Receiver, SyncSender},
+        Arc, Mutex,
+    },
+    thread::{Builder, JoinHandle},
+    time::{Duration, Instant},
+};
+
+/// The maximum number of spans waiting to be written
+const TIMELINE_CAPACITY: usize = 64 * 1024;
+/// The process id all spans are reported with
+const TIMELINE_PID: u32 = 1;
+
+#[derive(Debug, Clone, Copy)]
+/// The threads spans are recorded on
+pub(crate) enum TimelineThread {
+    /// The simulator thread, which runs the HAP handlers
+    Simulator = 1,
+    /// The fuzzer thread, which runs the LibAFL stages
+    Fuzzer = 2,
+}
+
+impl TimelineThread {
+    fn name(&self) -> &'static str {
+        match self {
+            TimelineThread::Simulator => "Simulator",
+            TimelineThread::Fuzzer => "Fuzzer",
+        }
+    }
+}
+
+#[derive(Debug, Clone, Copy)]
+/// A span of work on a thread, in microseconds since the timeline started
+struct TimelineSpan {
+    name: &'static str,
+    thread: TimelineThread,
+    start: u64,
+    duration: u64,
+}
+
+#[derive(Debug, Clone, Copy)]
+/// A message to the writer thread
+enum TimelineMessage {
+    /// A span to write
+    Span(TimelineSpan),
+    /// Close the timeline and stop writing
+    Finish,
+}
+
+#[derive(Debug, Serialize)]
+/// An event in the Chrome trace event format
+struct TraceEvent<'a> {
+    name: &'a str,
+    ph: &'static str,
+    #[serde(skip_serializing_if = "Option::is_none")]
+    ts: Option<u64>,
+    #[serde(skip_serializing_if = "Option::is_none")]
+    dur: Option<u64>,
+    pid: u32,
+    tid: u32,
+    #[serde(skip_serializing_if = "Option::is_none")]
+    args: Option<TraceEventArgs<'a>>,
+}
+
+#[derive(Debug, Serialize)]
+struct TraceEventArgs<'a> {
+    name: &'a str,
+}
+
+#[derive(Debug, Clone)]
+/// A handle to the timeline, which can be cloned to record spans from any thread
+pub(crate) struct Timeline {
+    /// The time the timeline started, which span times are relative to
+    epoch: Instant,
+    /// Spans waiting to be written
+    messages: SyncSender<TimelineMessage>,
+    /// The number of spans dropped because the channel was full, since it was last recorded
+    dropped: Arc<AtomicU64>,
+    /// The writer thread, until the timeline is finished
+    writer: Arc<Mutex<Option<JoinHandle<()>>>>,
+}
+
+impl Timeline {
+    /// Start a timeline written to `path` by a new writer thread. Spans starting more than
+    /// `duration` after the timeline starts are not recorded, and the timeline is closed
+    /// when the first one is. A zero `duration` records every span.
+    pub fn start<P>(path: P, duration: Duration) -> Result<Self>
+    where
+        P: AsRef<Path>,
+    {
+        let file = File::create(path.as_ref()).map_err(|e| {
+            anyhow!(
+                "Failed to create timeline file {}: {e}",
+                path.as_ref().display()
+            )
+        })?;
+        let (messages, rx) = sync_channel(TIMELINE_CAPACITY);
+        let dropped = Arc::new(AtomicU64::new(0));
+        let epoch = Instant::now();
+        let duration = (!duration.is_zero()).then(|| duration.as_micros() as u64);
+
+        let writer_dropped = dropped.clone();
+
+        let writer = Builder::new()
+            .name("tsffs-timeline".to_string())
+            .spawn(move || {
+                if let Err(e) =
+                    Self::write(BufWriter::new(file), rx, writer_dropped, epoch, duration)
+                {
+                    eprintln!("Failed to write timeline: {e}");
+                }
+            })?;
+
+        Ok(Self {
+            epoch,
+            messages,
+            dropped,
+            writer: Arc::new(Mutex::new(Some(writer))),
+        })
+    }
+
+    /// Write the spans recorded so far, close the timeline, and wait for the writer thread to
+    /// exit. Spans recorded afterward are dropped. This must be called before the simulator
+    /// exits, which would otherwise kill the writer thread before it writes the last spans.
+    pub fn finish(&self) {
+        // NOTE: This fails if the writer already exited because the duration was reached
+        let _ = self.messages.send(TimelineMessage::Finish);
+
+        if let Some(writer) = self.writer.lock().ok().and_then(|mut w| w.take()) {
+            let _ = writer.join();
+        }
+    }
+
+    /// The current time in microseconds since the timeline started
+    pub fn now(&self) -> u64 {
+        self.epoch.elapsed().as_micros() as u64
+    }
+
+    /// Record a span named `name` on `thread` from `start`, as returned by `now`, until now
+    pub fn record(&self, name: &'static str, thread: TimelineThread, start: u64) {
+        let span = TimelineSpan {
+            name,
+            thread,
+            start,
+            duration: self.now().saturating_sub(start),
+        };
+
+        if self.messages.try_send(TimelineMessage::Span(span)).is_err() {
+            self.dropped.fetch_add(1, Ordering::Relaxed);
+        }
+    }
+
+    /// Write spans received from `rx` until the timeline is finished, a span starts after
+    /// `duration` microseconds, or every sender is dropped. The file is flushed each time the
+    /// channel is drained, so it is usable while the fuzzer is running. Viewers accept the
+    /// array of events without its closing bracket, which is written when writing stops, so
+    /// the finished file is valid JSON.
+    fn write(
+        mut writer: BufWriter<File>,
+        rx: Receiver<TimelineMessage>,
+        dropped: Arc<AtomicU64>,
+        epoch: Instant,
+        duration: Option<u64>,
+    ) -> Result<()> {
+        writer.write_all(b"[\n")?;
+        let mut first = true;
+
+        for thread in [TimelineThread::Simulator, TimelineThread::Fuzzer] {
+            Self::write_event(
+                &mut writer,
+                &mut first,
+                &TraceEvent {
+                    name: "thread_name",
+                    ph: "M",
+                    ts: None,
+                    dur: None,
+                    pid: TIMELINE_PID,
+                    tid: thread as u32,
+                    args: Some(TraceEventArgs {
+                        name: thread.name(),
+                    }),
+                },
+            )?;
+        }
+
+        'write: while let Ok(message) = rx.recv() {
+            for message in Some(message).into_iter().chain(rx.try_iter()) {
+                let span = match message {
+                    TimelineMessage::Span(span) => span,
+                    TimelineMessage::Finish => break 'write,
+                };
+
+                if duration.is_some_and(|duration| span.start > duration) {
+                    Self::write_event(
+                        &mut writer,
+                        &mut first,
+                        &TraceEvent {
+                            name: "timeline duration reached",
+                            ph: "i",
+                            ts: duration,
+                            dur: None,
+                            pid: TIMELINE_PID,
+                            tid: TimelineThread::Fuzzer as u32,
+                            args: None,
+                        },
+                    )?;
+                    break 'write;
+                }
+
+                Self::write_event(
+                    &mut writer,
+                    &mut first,
+                    &TraceEvent {
+                        name: span.name,
+                        ph: "X",
+                        ts: Some(span.start),
+                        dur: Some(span.duration),
+                        pid: TIMELINE_PID,
+                        tid: span.thread as u32,
+                        args: None,
+                    },
+                )?;
+            }
+
+            Self::write_dropped(&mut writer, &mut first, &dropped, epoch)?;
+            writer.flush()?;
+        }
+
+        Self::write_dropped(&mut writer, &mut first, &dropped, epoch)?;
+        writer.write_all(b"\n]\n")?;
+        writer.flush()?;
+
+        Ok(())
+    }
+
+    /// Mark the number of spans dropped since the last mark, if any were
+    fn write_dropped(
+        writer: &mut BufWriter<File>,
+        first: &mut bool,
+        dropped: &Arc<AtomicU64>,
+        epoch: Instant,
+    ) -> Result<()> {
+        let dropped = dropped.swap(0, Ordering::Relaxed);
+
+        if dropped > 0 {
+            Self::write_event(
+                writer,
+                first,
+                &TraceEvent {
+                    name: &format!("{dropped} spans dropped"),
+                    ph: "i",
+                    ts: Some(epoch.elapsed().as_micros() as u64),
+                    dur: None,
+                    pid: TIMELINE_PID,
+                    tid: TimelineThread::Fuzzer as u32,
+                    args: None,
+                },
+            )?;
+        }
+
+        Ok(())
+    }
+
+    /// Write an event to the array of events, separated from the event before it unless it is
+    /// the `first`
+    fn write_event(
+        writer: &mut BufWriter<File>,
+        first: &mut bool,
+        event: &TraceEvent,
+    ) -> Result<()> {
+        if !*first {
+            writer.write_all(b",\n")?;
+        }
+
+        *first = false;
+        to_writer(&mut *writer, event)?;
+        Ok(())
+    }
+}
+
+/// A stage which records a span on the fuzzer thread each time the wrapped stage is
+/// performed, if a timeline is enabled
+pub(crate) struct TimedStage<ST> {
+    name: &'static str,
+    stage: ST,
+    timeline: Option<Timeline>,
+}
+
+impl<ST> TimedStage<ST> {
+    /// Wrap `stage`, recording its spans with the name `name`
+    pub fn new(name: &'static str, stage: ST, timeline: Option<Timeline>) -> Self {
+        Self {
+            name,
+            stage,
+            timeline,
+        }
+    }
+}
+
+impl<ST> UsesState for TimedStage<ST>
+where
+    ST: UsesState,
+    ST::State: State,
+{
+    type State = ST::State;
+}
+
+impl<E, EM, ST, Z> Stage<E, EM, Z> for TimedStage<ST>
+where
+    ST: Stage<E, EM, Z>,
+    ST::State: State,
+    E: UsesState<State = ST::State>,
+    EM: UsesState<State = ST::State>,
+    Z: UsesState<State = ST::State>,
+{
+    type Progress = ST::Progress;
+
+    fn perform(
+        &mut self,
+        fuzzer: &mut Z,
+        executor: &mut E,
+        state: &mut Self::State,
+        manager: &mut EM,
+    ) -> Result<(), libafl::Error> {
+        let start = self.timeline.as_ref().map(Timeline::now);
+
+        let result = self.stage.perform(fuzzer, executor, state, manager);
+
+        if let (Some(timeline), Some(start)) = (self.timeline.as_ref(), start) {
+            timeline.record(self.name, TimelineThread::Fuzzer, start);
+        }
+
+        result
+    }
+}
@@ -15,6 +15,8 @@ pub enum MagicNumber {
     StartBufferPtrSizePtrVal = 3,
     StopNormal = 4,
     StopAssert = 5,
+    StartRegisters = 6,
+    Guard = 7,
 }
 
 impl Display for MagicNumber {
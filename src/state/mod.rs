@@ -3,17 +3,58 @@
 
 //! Definitions for tracking the state of the fuzzer
 
-use anyhow::{anyhow, Error, Result};
 use serde::{Deserialize, Serialize};
-use serde_json::{from_str, to_string};
 use simics::api::ConfObject;
-use std::{
-    fmt::{Display, Formatter},
-    ptr::null_mut,
-    str::FromStr,
-};
+use std::collections::BTreeMap;
 
-use crate::{magic::MagicNumber, ManualStartInfo};
+use crate::{magic::MagicNumber, ManualStartInfo, StartInfo};
+
+/// The size of the memory pages hashed to detect drift of the snapshot state
+pub(crate) const DRIFT_CHECK_PAGE_SIZE: u64 = 4096;
+/// The number of bytes of a page read at once when hashing it, which is the most a memory
+/// space inquiry read can return
+pub(crate) const DRIFT_CHECK_READ_SIZE: usize = 1024;
+/// The maximum number of return addresses walked in the call stack of a solution state
+pub(crate) const SOLUTION_STATE_STACK_DEPTH: usize = 64;
+
+#[derive(Debug, Clone, Default)]
+/// Digests of the state of the traced processors and a set of memory pages, recorded when the
+/// initial snapshot is saved and compared after it is restored to detect state which the
+/// restore does not reproduce
+pub(crate) struct StateDigest {
+    /// The digest of the integer registers of each traced processor, by processor number
+    pub registers: BTreeMap<i32, u64>,
+    /// The digest of each checked page, by physical page address
+    pub pages: BTreeMap<u64, u64>,
+}
+
+#[derive(Debug, Clone, Serialize)]
+/// The state of a traced processor when a solution occurred
+pub(crate) struct ProcessorState {
+    /// The value of each readable integer register, by name
+    pub registers: BTreeMap<String, u64>,
+    /// The program counter followed by the return addresses found by walking the frame
+    /// pointer chain
+    pub call_stack: Vec<u64>,
+    /// The address which caused the memory access fault, for memory access fault solutions
+    pub fault_address: Option<u64>,
+}
+
+#[derive(Debug, Clone, Serialize)]
+/// A record of the state of the target when a solution occurred, captured before the initial
+/// snapshot is restored and written next to the solution
+pub(crate) struct SolutionState {
+    /// The kind of solution
+    pub kind: SolutionKind,
+    /// The exception number, for exception solutions
+    pub exception: Option<i64>,
+    /// The iteration the solution occurred in
+    pub iteration: usize,
+    /// The state of each traced processor, by processor number
+    pub processors: BTreeMap<i32, ProcessorState>,
+    /// The targets of the most recent edges taken during the iteration, oldest first
+    pub recent_edges: Vec<u64>,
+}
 
 #[derive(Serialize, Deserialize, Debug, Clone)]
 pub(crate) enum SolutionKind {
@@ -23,7 +64,7 @@ pub(crate) enum SolutionKind {
     Manual,
 }
 
-#[derive(Debug, Clone, Serialize, Deserialize)]
+#[derive(Debug, Clone)]
 /// Definition of all the reasons the simulator could be stopped by the fuzzer. In general,
 /// callbacks in the fuzzer, for example [`Driver::on_magic_instruction`] may be called
 /// asynchronously and stop the simulation.
@@ -32,30 +73,46 @@ pub(crate) enum StopReason {
         magic_number: MagicNumber,
     },
     ManualStart {
-        #[serde(skip, default = "null_mut")]
         processor: *mut ConfObject,
         info: ManualStartInfo,
     },
     ManualStartWithoutBuffer {
-        #[serde(skip, default = "null_mut")]
         processor: *mut ConfObject,
     },
+    CheckpointStart {
+        processor: *mut ConfObject,
+        info: Option<StartInfo>,
+    },
     ManualStop,
     Solution {
         kind: SolutionKind,
     },
 }
 
-impl Display for StopReason {
-    fn fmt(&self, f: &mut Formatter<'_>) -> std::fmt::Result {
-        write!(f, "{}", to_string(self).unwrap_or_default())
-    }
-}
-
-impl FromStr for StopReason {
-    type Err = Error;
-
-    fn from_str(s: &str) -> Result<Self> {
-        from_str(s).map_err(|e| anyhow!("Failed to deserialize from string: {e}"))
+impl StopReason {
+    /// A short, constant code for the reason, used as the message the simulation is broken
+    /// with. The full reason is kept by the fuzzer and handled when the simulation stops, so
+    /// the message only needs to identify the reason to the user and never needs to be
+    /// formatted or parsed.
+    pub fn code(&self) -> &'static str {
+        match self {
+            StopReason::Magic { .. } => "tsffs: magic",
+            StopReason::ManualStart { .. } => "tsffs: start",
+            StopReason::ManualStartWithoutBuffer { .. } => "tsffs: start without buffer",
+            StopReason::CheckpointStart { .. } => "tsffs: checkpoint start",
+            StopReason::ManualStop => "tsffs: stop",
+            StopReason::Solution {
+                kind: SolutionKind::Timeout,
+            } => "tsffs: solution (timeout)",
+            StopReason::Solution {
+                kind: SolutionKind::Exception,
+            } => "tsffs: solution (exception)",
+            StopReason::Solution {
+                kind: SolutionKind::Breakpoint,
+            } => "tsffs: solution (breakpoint)",
+            StopReason::Solution {
+                kind: SolutionKind::Manual,
+            } => "tsffs: solution (manual)",
+        }
     }
 }
@@ -1,22 +1,32 @@
 // Copyright (C) 2024 Intel Corporation
 // SPDX-License-Identifier: Apache-2.0
 
-use anyhow::{anyhow, bail, Error, Result};
+use anyhow::{anyhow, bail, ensure, Error, Result};
 use ffi::ffi;
 use libafl::prelude::CmpValues;
 use libafl_bolts::{AsMutSlice, AsSlice};
 use libafl_targets::{AFLppCmpLogOperands, AFL_CMP_TYPE_INS, CMPLOG_MAP_H};
 use simics::{
     api::{
-        get_processor_number, sys::instruction_handle_t, AsConfObject, AttrValue, AttrValueType,
-        ConfObject,
+        branch_arcs, breakpoint, delete_breakpoint, free_attribute, get_mem_op_physical_address,
+        get_mem_op_size, get_object, get_processor_number, object_name, processor_privilege_level,
+        run_command, sys::instruction_handle_t, Access, AsConfObject, AttrValue, AttrValueType,
+        BranchRecorderDirection, BreakpointFlag, BreakpointId, BreakpointKind, ConfObject,
+        GenericAddress, GenericTransaction,
     },
     trace,
 };
-use std::{collections::HashMap, ffi::c_void, fmt::Display, num::Wrapping, str::FromStr};
+use std::{
+    collections::{hash_map::Entry, HashMap},
+    ffi::c_void,
+    fmt::Display,
+    mem::take,
+    num::Wrapping,
+    str::FromStr,
+};
 use typed_builder::TypedBuilder;
 
-use crate::{arch::ArchitectureOperations, Tsffs};
+use crate::{arch::ArchitectureOperations, StartInfo, Tsffs};
 
 #[derive(Debug, PartialEq, Eq, PartialOrd, Ord, Hash)]
 pub(crate) enum CmpExpr {
@@ -204,17 +214,530 @@ impl From<CoverageMode> for AttrValueType {
     }
 }
 
+/// The AFL hit count bucket of each hit count. Buckets are not their own buckets (a count of 3
+/// is bucket 4, and a count of 4 is bucket 8), so each map must be classified exactly once.
+const HIT_COUNT_BUCKETS: [u8; 256] = {
+    let mut buckets = [0; 256];
+    let mut count = 1;
+
+    while count < 256 {
+        buckets[count] = match count {
+            1 => 1,
+            2 => 2,
+            3 => 4,
+            4..=7 => 8,
+            8..=15 => 16,
+            16..=31 => 32,
+            32..=127 => 64,
+            _ => 128,
+        };
+        count += 1;
+    }
+
+    buckets
+};
+
 impl Tsffs {
+    /// The name of the branch recorder object created when `use_branch_recorder` is set
+    pub const BRANCH_RECORDER_NAME: &'static str = "tsffs_branch_recorder";
+
     fn log_pc(&mut self, pc: u64) -> Result<()> {
         let coverage_map = self.coverage_map.get_mut().ok_or_else(|| {
             anyhow!("Coverage map not initialized. This is a bug in the fuzzer or the target")
         })?;
         let afl_idx = (pc ^ self.coverage_prev_loc) % coverage_map.as_slice().len() as u64;
-        let mut cur_byte: Wrapping<u8> = Wrapping(coverage_map.as_slice()[afl_idx as usize]);
-        cur_byte += 1;
-        coverage_map.as_mut_slice()[afl_idx as usize] = cur_byte.0;
         self.coverage_prev_loc = (pc >> 1) % coverage_map.as_slice().len() as u64;
 
+        if self.capture_solution_state {
+            self.record_recent_edge(pc);
+        }
+
+        self.record_hits(afl_idx as usize, 1)
+    }
+
+    /// Log an edge which was taken `count` times. Branch recorder arcs are aggregated by
+    /// address and carry no order, so unlike `log_pc`, which hashes each target with the
+    /// previous target, the previous location is the source instruction of the edge. The same
+    /// edge therefore has a different map index than under instruction tracing, and corpora
+    /// are only comparable between runs using the same backend. Returns the AFL index of the
+    /// edge.
+    fn log_edge(&mut self, from: u64, to: u64, count: u64) -> Result<u64> {
+        let coverage_map = self.coverage_map.get_mut().ok_or_else(|| {
+            anyhow!("Coverage map not initialized. This is a bug in the fuzzer or the target")
+        })?;
+        let prev_loc = (from >> 1) % coverage_map.as_slice().len() as u64;
+        let afl_idx = (to ^ prev_loc) % coverage_map.as_slice().len() as u64;
+
+        if self.capture_solution_state {
+            self.record_recent_edge(to);
+        }
+
+        self.record_hits(afl_idx as usize, count)?;
+
+        Ok(afl_idx)
+    }
+
+    /// Record the target of an edge in the ring of the most recent edges kept for the state
+    /// captured at solutions
+    fn record_recent_edge(&mut self, target: u64) {
+        if self.solution_state_edges == 0 {
+            return;
+        }
+
+        if self.recent_edges.len() >= self.solution_state_edges {
+            self.recent_edges.pop_front();
+        }
+
+        self.recent_edges.push_back(target);
+    }
+
+    /// Record `count` hits of the coverage map entry at `afl_idx` according to the coverage
+    /// mode. If `classify_coverage_at_trace` is set, hits are counted in `hit_counts` and the
+    /// map entry holds the hit count bucket of the count, so the map does not need to be
+    /// classified after the iteration.
+    fn record_hits(&mut self, afl_idx: usize, count: u64) -> Result<()> {
+        let bucket = match self.coverage_mode {
+            CoverageMode::Once => Some(1),
+            CoverageMode::HitCount if self.classify_coverage_at_trace => {
+                if self.hit_counts.is_empty() {
+                    self.hit_counts = vec![0; Self::COVERAGE_MAP_SIZE];
+                }
+
+                let hits = &mut self.hit_counts[afl_idx];
+
+                if *hits == 0 {
+                    self.hit_count_indices.push(afl_idx);
+                }
+
+                // NOTE: Counts saturate instead of wrapping, so a hot edge never reads as unhit
+                *hits = hits.saturating_add(count.min(u8::MAX as u64) as u8);
+
+                Some(HIT_COUNT_BUCKETS[*hits as usize])
+            }
+            CoverageMode::HitCount => None,
+        };
+
+        let coverage_map = self.coverage_map.get_mut().ok_or_else(|| {
+            anyhow!("Coverage map not initialized. This is a bug in the fuzzer or the target")
+        })?;
+        let entry = &mut coverage_map.as_mut_slice()[afl_idx];
+
+        // NOTE: Truncating the count is equivalent to wrapping once per hit
+        *entry = bucket.unwrap_or_else(|| (Wrapping(*entry) + Wrapping(count as u8)).0);
+
+        Ok(())
+    }
+
+    /// Finish recording coverage for the current iteration before its exit kind is reported to
+    /// the fuzzer. Logs the arcs of the branch recorder, then either classifies the raw hit
+    /// counts in the coverage map into buckets, or, if the tracer already stored buckets,
+    /// clears the hit counts of the entries hit in this iteration.
+    pub fn finish_coverage(&mut self) -> Result<()> {
+        self.log_branch_arcs()?;
+
+        if self.classify_coverage_at_trace {
+            for afl_idx in self.hit_count_indices.drain(..) {
+                self.hit_counts[afl_idx] = 0;
+            }
+        } else {
+            let coverage_map = self.coverage_map.get_mut().ok_or_else(|| {
+                anyhow!("Coverage map not initialized. This is a bug in the fuzzer or the target")
+            })?;
+
+            coverage_map
+                .as_mut_slice()
+                .iter_mut()
+                .filter(|entry| **entry != 0)
+                .for_each(|entry| *entry = HIT_COUNT_BUCKETS[*entry as usize]);
+        }
+
+        Ok(())
+    }
+
+    /// Reset the tracing state carried between instructions after the initial snapshot is
+    /// restored, so nothing traced in one iteration affects the next
+    pub fn reset_trace_state(&mut self) {
+        self.coverage_prev_loc = 0;
+        self.pending_physical_edges.clear();
+        // Cleared here rather than when coverage is finished, so solution state captured
+        // between the two still has the edges of the iteration
+        self.recent_edges.clear();
+        self.last_cmp_site = None;
+        self.pending_cmp_site = None;
+        self.processors
+            .values_mut()
+            .for_each(|processor| processor.disassembler().reset());
+    }
+
+    /// Record `target` as an outcome of the pending compare site, if any. A site is only
+    /// pending while the conditional branch of the compare, which is either the compare
+    /// itself or the instruction right after it, executes, so `target` is that branch's
+    /// outcome. A site is solved once two different outcomes have been observed for it.
+    fn record_cmp_site_outcome(&mut self, target: u64) {
+        let Some(site) = self.pending_cmp_site.take() else {
+            return;
+        };
+
+        if self.solved_cmp_sites.contains(&site) {
+            return;
+        }
+
+        match self.cmp_site_outcomes.entry(site) {
+            Entry::Vacant(e) => {
+                e.insert(target);
+            }
+            Entry::Occupied(e) => {
+                if *e.get() != target {
+                    e.remove();
+                    self.solved_cmp_sites.insert(site);
+                }
+            }
+        }
+    }
+
+    /// Attach the coverage branch recorder to a processor, creating the recorder on first use
+    pub fn attach_branch_recorder(&mut self, cpu: *mut ConfObject) -> Result<()> {
+        if self.branch_recorder.get().is_none() {
+            free_attribute(run_command(format!(
+                "new-branch-recorder name = {}",
+                Self::BRANCH_RECORDER_NAME
+            ))?)?;
+            self.branch_recorder
+                .set(get_object(Self::BRANCH_RECORDER_NAME)?)
+                .map_err(|_| anyhow!("Branch recorder already set"))?;
+        }
+
+        free_attribute(run_command(format!(
+            "{}.attach-branch-recorder {}",
+            object_name(cpu)?,
+            Self::BRANCH_RECORDER_NAME
+        ))?)?;
+
+        Ok(())
+    }
+
+    /// Discard all arcs recorded by the coverage branch recorder, if there is one
+    pub fn clear_branch_recorder(&mut self) -> Result<()> {
+        if self.branch_recorder.get().is_some() {
+            free_attribute(run_command(format!(
+                "{}.clean",
+                Self::BRANCH_RECORDER_NAME
+            ))?)?;
+        }
+
+        Ok(())
+    }
+
+    /// Hash the arcs recorded by the coverage branch recorder during the current iteration
+    /// into the coverage map, then discard them. Does nothing if there is no branch recorder.
+    pub fn log_branch_arcs(&mut self) -> Result<()> {
+        let Some(recorder) = self.branch_recorder.get().copied() else {
+            return Ok(());
+        };
+
+        for arc in branch_arcs(
+            recorder,
+            0,
+            GenericAddress::MAX,
+            BranchRecorderDirection::BR_Direction_From,
+        )? {
+            let afl_idx = self.log_edge(arc.addr_from, arc.addr_to, arc.count as u64)?;
+
+            if self.coverage_reporting && self.edges_seen.insert(arc.addr_to) {
+                self.edges_seen_since_last.insert(arc.addr_to, afl_idx);
+            }
+        }
+
+        self.clear_branch_recorder()
+    }
+
+    /// Capture the address space of the start processor when the start harness is reached,
+    /// if `trace_start_address_space` is set
+    pub fn capture_trace_address_space_if_needed(&mut self) -> Result<()> {
+        if !self.trace_start_address_space || self.trace_address_space.is_some() {
+            return Ok(());
+        }
+
+        let start_processor = self
+            .start_processor()
+            .ok_or_else(|| anyhow!("No start processor"))?;
+        let register = start_processor.address_space_register_number()?;
+        let address_space = start_processor.address_space(register)?;
+        let start_processor_number = *self
+            .start_processor_number
+            .get()
+            .ok_or_else(|| anyhow!("No start processor number"))?;
+
+        self.address_space_registers
+            .insert(start_processor_number, register);
+        self.trace_address_space = Some(address_space);
+
+        Ok(())
+    }
+
+    /// Check whether the instruction a processor is about to execute should be traced under
+    /// the `trace_privilege_levels` and `trace_start_address_space` filters, and save the
+    /// result for the callback after the instruction. This is called once per instruction.
+    /// When execution on the processor leaves or re-enters the traced scope, the previous
+    /// location is reset, so the first edge traced after a transition is not hashed against
+    /// the last edge traced before it.
+    fn update_trace_scope(&mut self, cpu: *mut ConfObject, processor_number: i32) -> Result<bool> {
+        let in_scope = self.check_trace_scope(cpu, processor_number)?;
+
+        if self.trace_scope.insert(processor_number, in_scope) != Some(in_scope) {
+            self.coverage_prev_loc = 0;
+        }
+
+        Ok(in_scope)
+    }
+
+    /// Whether the instruction a processor is executing is in the traced scope, as saved by
+    /// `update_trace_scope` before the instruction
+    fn in_trace_scope(&self, processor_number: i32) -> bool {
+        self.trace_scope
+            .get(&processor_number)
+            .copied()
+            .unwrap_or(true)
+    }
+
+    /// Check the instruction a processor is executing against the `trace_privilege_levels`
+    /// and `trace_start_address_space` filters
+    fn check_trace_scope(&mut self, cpu: *mut ConfObject, processor_number: i32) -> Result<bool> {
+        if !self.trace_privilege_levels.is_empty()
+            && !self
+                .trace_privilege_levels
+                .contains(&(processor_privilege_level(cpu)? as i64))
+        {
+            return Ok(false);
+        }
+
+        if let Some(address_space) = self.trace_address_space {
+            let Some(arch) = self.processors.get_mut(&processor_number) else {
+                return Ok(false);
+            };
+
+            let register = match self.address_space_registers.get(&processor_number) {
+                Some(register) => *register,
+                None => {
+                    let register = arch.address_space_register_number()?;
+                    self.address_space_registers
+                        .insert(processor_number, register);
+                    register
+                }
+            };
+
+            if arch.address_space(register)? != address_space {
+                return Ok(false);
+            }
+        }
+
+        Ok(true)
+    }
+
+    /// Set a read breakpoint on the testcase buffer to track the testcase bytes read by the
+    /// target, if `track_input_access` is set and the harness provides a buffer
+    pub fn watch_input_buffer_if_needed(&mut self) -> Result<()> {
+        if !self.track_input_access || self.input_access_breakpoint.is_some() {
+            return Ok(());
+        }
+
+        let Some((address, size)) = self.start_info.get().and_then(|si| {
+            si.address
+                .as_ref()
+                .map(|a| (a.physical_address(), si.size.maximum_size()))
+        }) else {
+            return Ok(());
+        };
+
+        let physical_memory = self
+            .start_processor()
+            .ok_or_else(|| anyhow!("No start processor"))?
+            .processor_info_v2()
+            .get_physical_memory()?;
+
+        self.input_access_breakpoint = Some(breakpoint(
+            physical_memory,
+            BreakpointKind::Sim_Break_Physical,
+            Access::Sim_Access_Read,
+            address,
+            size as u64,
+            BreakpointFlag::Sim_Breakpoint_Simulation,
+        )?);
+
+        self.input_access
+            .lock()
+            .map_err(|e| anyhow!("Failed to lock input access: {e}"))?
+            .enabled = true;
+
+        Ok(())
+    }
+
+    /// Set breakpoints on the guard region of `length` bytes at physical `address` of
+    /// `physical_memory`, if it is not already guarded. Writes to the region, and reads if
+    /// `guard_reads` is set, are treated as solutions. Returns the breakpoints set.
+    pub fn guard_region(
+        &mut self,
+        physical_memory: *mut ConfObject,
+        address: u64,
+        length: u64,
+    ) -> Result<Vec<BreakpointId>> {
+        if length == 0 || !self.guarded_regions.insert((address, length)) {
+            return Ok(Vec::new());
+        }
+
+        let accesses = if self.guard_reads {
+            &[Access::Sim_Access_Write, Access::Sim_Access_Read][..]
+        } else {
+            &[Access::Sim_Access_Write][..]
+        };
+
+        let breakpoints = accesses
+            .iter()
+            .map(|access| {
+                Ok(breakpoint(
+                    physical_memory,
+                    BreakpointKind::Sim_Break_Physical,
+                    *access,
+                    address,
+                    length,
+                    BreakpointFlag::Sim_Breakpoint_Simulation,
+                )?)
+            })
+            .collect::<Result<Vec<_>>>()?;
+
+        self.guard_breakpoints.extend(breakpoints.iter().copied());
+
+        debug!(
+            self.as_conf_object(),
+            "Guarding {length} bytes at physical address {address:#x}"
+        );
+
+        Ok(breakpoints)
+    }
+
+    /// Reserve the guard region at the end of the testcase buffer by reducing the maximum
+    /// testcase size of `start_info` by `guard_testcase_buffer` bytes. The region is inside
+    /// the buffer, so guarding it never reports accesses to memory the target owns, and it
+    /// is contiguous with the testcase in the same way the testcase is written.
+    pub fn reserve_testcase_buffer_guard(&self, start_info: &mut StartInfo) -> Result<()> {
+        let redzone = self.guard_testcase_buffer as usize;
+
+        if redzone == 0 || start_info.address.is_none() {
+            return Ok(());
+        }
+
+        let maximum_size = start_info.size.maximum_size();
+
+        ensure!(
+            redzone < maximum_size,
+            "Testcase buffer guard region of {redzone} bytes does not fit in the {maximum_size} byte testcase buffer"
+        );
+
+        start_info.size.set_maximum_size(maximum_size - redzone);
+        start_info.contents.truncate(maximum_size - redzone);
+
+        Ok(())
+    }
+
+    /// Guard the regions in `guard_regions` and, if `guard_testcase_buffer` is set, the
+    /// region reserved at the end of the testcase buffer. Called when the start harness is
+    /// reached.
+    pub fn guard_regions_if_needed(&mut self) -> Result<()> {
+        if self.guard_regions.is_empty() && self.guard_testcase_buffer == 0 {
+            return Ok(());
+        }
+
+        let physical_memory = self
+            .start_processor()
+            .ok_or_else(|| anyhow!("No start processor"))?
+            .processor_info_v2()
+            .get_physical_memory()?;
+
+        for region in self.guard_regions.clone() {
+            let [address, length] = region[..] else {
+                bail!("Guard region {region:?} is not an [address, length] pair");
+            };
+
+            self.guard_region(physical_memory, address, length)?;
+        }
+
+        // The maximum size was already reduced by the size of the region
+        let redzone = self.guard_testcase_buffer;
+
+        if let Some((address, size)) = self.start_info.get().and_then(|si| {
+            si.address
+                .as_ref()
+                .map(|a| (a.physical_address(), si.size.maximum_size() as u64))
+        }) {
+            if redzone > 0 {
+                self.guard_region(physical_memory, address + size, redzone)?;
+            }
+        }
+
+        Ok(())
+    }
+
+    /// Guard the region declared by a guard harness executed by the processor. Regions
+    /// declared before the start harness is reached stay guarded for the rest of the
+    /// campaign. Regions declared during an iteration, for example on the stack, are only
+    /// guarded until the initial snapshot is restored.
+    pub fn on_magic_guard(&mut self, processor_number: i32) -> Result<()> {
+        let iteration = self.have_initial_snapshot();
+        let processor = self
+            .processors
+            .get_mut(&processor_number)
+            .ok_or_else(|| anyhow!("Processor not found"))?;
+        let physical_memory = processor.processor_info_v2().get_physical_memory()?;
+        let ranges = processor.get_magic_guard()?;
+
+        for (address, length) in ranges {
+            let breakpoints = self.guard_region(physical_memory, address, length)?;
+
+            if iteration && !breakpoints.is_empty() {
+                self.iteration_guards.insert((address, length), breakpoints);
+            }
+        }
+
+        Ok(())
+    }
+
+    /// Remove the guard regions declared during the iteration which just finished. Called
+    /// after the initial snapshot is restored.
+    pub fn remove_iteration_guards(&mut self) -> Result<()> {
+        for (region, breakpoints) in take(&mut self.iteration_guards) {
+            for breakpoint in breakpoints {
+                delete_breakpoint(breakpoint)?;
+                self.guard_breakpoints.remove(&breakpoint);
+            }
+
+            self.guarded_regions.remove(&region);
+        }
+
+        Ok(())
+    }
+
+    /// Record a read of the testcase buffer by the target
+    pub fn log_input_access(&mut self, transaction: *mut GenericTransaction) -> Result<()> {
+        let base = self
+            .start_info
+            .get()
+            .ok_or_else(|| anyhow!("No start info"))?
+            .address
+            .as_ref()
+            .ok_or_else(|| anyhow!("No testcase buffer"))?
+            .physical_address();
+        let (address, size) = unsafe {
+            (
+                get_mem_op_physical_address(transaction),
+                get_mem_op_size(transaction),
+            )
+        };
+
+        self.input_access
+            .lock()
+            .map_err(|e| anyhow!("Failed to lock input access: {e}"))?
+            .record(address.saturating_sub(base) as usize, size as usize);
+
         Ok(())
     }
 
@@ -275,26 +798,50 @@ impl Tsffs {
     ) -> Result<()> {
         let processor_number = get_processor_number(cpu)?;
 
-        if self.coverage_enabled {
+        if self.coverage_enabled && self.in_trace_scope(processor_number) {
             if let Some(arch) = self.processors.get_mut(&processor_number) {
-                match arch.trace_pc(handle) {
-                    Ok(r) => {
-                        if let Some(pc) = r.edge {
-                            if self.coverage_reporting && self.edges_seen.insert(pc) {
-                                let coverage_map = self.coverage_map.get_mut().ok_or_else(|| {
-                                    anyhow!("Coverage map not initialized. This is a bug in the fuzzer or the target")
-                                })?;
-                                let afl_idx = (pc ^ self.coverage_prev_loc)
-                                    % coverage_map.as_slice().len() as u64;
-                                self.edges_seen_since_last.insert(pc, afl_idx);
-                            }
-                            self.log_pc(pc)?;
+                let edge = if self.coverage_physical_addresses {
+                    // The target of a control flow instruction is the instruction executed
+                    // after it, whose physical address is read from its own handle
+                    let target = if self.pending_physical_edges.remove(&processor_number) {
+                        Some(arch.cpu_instruction_query().physical_address(handle)?)
+                    } else {
+                        None
+                    };
+
+                    if arch
+                        .is_control_flow(handle, self.trace_direct_branches)
+                        .unwrap_or(false)
+                    {
+                        self.pending_physical_edges.insert(processor_number);
+                    }
+
+                    target
+                } else {
+                    match arch.trace_pc(handle, self.trace_direct_branches) {
+                        Ok(r) => r.edge,
+                        Err(_) => {
+                            // This is not really an error, but we may want to know  about it
+                            // sometimes when debugging
+                            // trace!(self.as_conf_object(), "Error tracing for PC: {e}");
+                            None
                         }
                     }
-                    Err(_) => {
-                        // This is not really an error, but we may want to know  about it
-                        // sometimes when debugging
-                        // trace!(self.as_conf_object(), "Error tracing for PC: {e}");
+                };
+
+                if let Some(pc) = edge {
+                    if self.coverage_reporting && self.edges_seen.insert(pc) {
+                        let coverage_map = self.coverage_map.get_mut().ok_or_else(|| {
+                            anyhow!("Coverage map not initialized. This is a bug in the fuzzer or the target")
+                        })?;
+                        let afl_idx =
+                            (pc ^ self.coverage_prev_loc) % coverage_map.as_slice().len() as u64;
+                        self.edges_seen_since_last.insert(pc, afl_idx);
+                    }
+                    self.log_pc(pc)?;
+
+                    if self.cmplog_skip_solved_sites {
+                        self.record_cmp_site_outcome(pc);
                     }
                 }
             }
@@ -318,13 +865,43 @@ impl Tsffs {
         handle: *mut instruction_handle_t,
     ) -> Result<()> {
         let processor_number = get_processor_number(cpu)?;
+        let cmplog = self.cmplog && self.cmplog_enabled;
+
+        // The scope is checked here for both callbacks, because this callback always runs
+        // first and the scope cannot change during an instruction
+        if !(cmplog || (self.coverage_enabled && !self.use_branch_recorder))
+            || !self.update_trace_scope(cpu, processor_number)?
+        {
+            return Ok(());
+        }
 
-        if self.cmplog && self.cmplog_enabled {
+        if cmplog {
             if let Some(arch) = self.processors.get_mut(&processor_number) {
-                match arch.trace_cmp(handle) {
+                // A pending site not credited by the previous instruction's edge is dropped
+                let last_cmp_site = self.last_cmp_site.take();
+                self.pending_cmp_site = None;
+
+                // Solved sites are skipped before their operands are evaluated. The set is
+                // only filled when `cmplog_skip_solved_sites` is set.
+                match arch.trace_cmp(handle, &self.solved_cmp_sites) {
                     Ok(r) => {
+                        let conditional_branch = self.cmplog_skip_solved_sites
+                            && arch.disassembler().last_was_conditional_branch();
+
                         if let Some((pc, types, cmp)) = r.cmp {
+                            if self.cmplog_skip_solved_sites {
+                                if conditional_branch {
+                                    self.pending_cmp_site = Some(pc);
+                                } else {
+                                    self.last_cmp_site = Some(pc);
+                                }
+                            }
+
                             self.log_cmp(pc, types.clone(), cmp.clone())?;
+                        } else if conditional_branch && !arch.disassembler().last_was_cmp() {
+                            // A branch which compares its own operands at a solved site does
+                            // not credit the comparison before it
+                            self.pending_cmp_site = last_cmp_site;
                         }
                     }
                     Err(_) => {
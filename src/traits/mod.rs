@@ -11,7 +11,16 @@ pub trait TracerDisassembler {
     fn last_was_control_flow(&self) -> bool;
     fn last_was_call(&self) -> bool;
     fn last_was_ret(&self) -> bool;
+    /// Whether the last instruction was a control flow instruction whose target is fully
+    /// determined by its address and encoding, such as a direct unconditional jump or call.
+    /// Conditional and indirect control flow instructions are not direct unconditional.
+    fn last_was_direct_unconditional(&self) -> bool;
+    /// Whether the last instruction was a conditional branch, whose outcome is the address of
+    /// the instruction executed after it
+    fn last_was_conditional_branch(&self) -> bool;
     fn last_was_cmp(&self) -> bool;
     fn cmp(&self) -> Vec<CmpExpr>;
     fn cmp_type(&self) -> Vec<CmpType>;
+    /// Reset state carried between traced instructions when the initial snapshot is restored
+    fn reset(&mut self) {}
 }
@@ -0,0 +1,107 @@
+// Copyright (C) 2024 Intel Corporation
+// SPDX-License-Identifier: Apache-2.0
+
+use anyhow::{anyhow, Result};
+use indoc::formatdoc;
+use ispm_wrapper::data::ProjectPackage;
+use simics_test::TestEnvSpec;
+use std::path::PathBuf;
+
+/// Run the fast UEFI target for 1000 iterations and return the number of edges found, failing
+/// if the campaign does not stop on its own
+fn run_speedtest(name: &str, use_branch_recorder: bool) -> Result<usize> {
+    let output = TestEnvSpec::builder()
+        .name(name)
+        .package_crates([PathBuf::from(env!("CARGO_MANIFEST_DIR"))])
+        .packages([
+            ProjectPackage::builder()
+                .package_number(1000)
+                .version("latest")
+                .build(),
+            ProjectPackage::builder()
+                .package_number(2096)
+                .version("latest")
+                .build(),
+            ProjectPackage::builder()
+                .package_number(8112)
+                .version("latest")
+                .build(),
+        ])
+        .cargo_target_tmpdir(env!("CARGO_TARGET_TMPDIR"))
+        .directories([PathBuf::from(env!("CARGO_MANIFEST_DIR"))
+            .join("tests")
+            .join("rsrc")
+            .join("x86_64-uefi")])
+        .build()
+        .to_env()?
+        .test(formatdoc! {r#"
+            load-module tsffs
+            init-tsffs
+
+            @tsffs.log_level = 2
+            @tsffs.start_on_harness = True
+            @tsffs.stop_on_harness = True
+            @tsffs.timeout = 3.0
+            @tsffs.exceptions = [14]
+            @tsffs.generate_random_corpus = True
+            @tsffs.iteration_limit = 1000
+            @tsffs.use_snapshots = True
+            @tsffs.coverage_reporting = True
+            @tsffs.use_branch_recorder = {}
+
+            load-target "qsp-x86/uefi-shell" namespace = qsp machine:hardware:storage:disk0:image = "minimal_boot_disk.craff"
+
+            script-branch {{
+                bp.time.wait-for seconds = 15
+                qsp.serconsole.con.input "\n"
+                bp.time.wait-for seconds = .5
+                qsp.serconsole.con.input "FS0:\n"
+                bp.time.wait-for seconds = .5
+                local $manager = (start-agent-manager)
+                qsp.serconsole.con.input ("SimicsAgent.efi --download " + (lookup-file "%simics%/test-fast.efi") + "\n")
+                bp.time.wait-for seconds = .5
+                qsp.serconsole.con.input "test-fast.efi\n"
+            }}
+
+            script-branch {{
+                bp.time.wait-for seconds = 240
+                quit 1
+            }}
+
+            run
+        "#, if use_branch_recorder { "True" } else { "False" }})?;
+
+    let output_str = String::from_utf8_lossy(&output.stdout);
+
+    println!("{output_str}");
+
+    let stopped = output_str
+        .lines()
+        .find(|l| l.contains("Configured iteration count 1000 reached"))
+        .ok_or_else(|| anyhow!("Campaign did not stop at the iteration limit"))?;
+
+    Ok(stopped
+        .rsplit_once(", ")
+        .and_then(|(_, edges)| edges.split_whitespace().next())
+        .ok_or_else(|| anyhow!("No edge count in stop message: {stopped}"))?
+        .parse()?)
+}
+
+#[test]
+#[cfg_attr(miri, ignore)]
+fn test_x86_64_magic_speedtest_branch_recorder() -> Result<()> {
+    let instruction_edges = run_speedtest(
+        "test_x86_64_magic_speedtest_branch_recorder_instructions",
+        false,
+    )?;
+    let branch_recorder_edges = run_speedtest("test_x86_64_magic_speedtest_branch_recorder", true)?;
+
+    println!(
+        "Instruction tracing found {instruction_edges} edges, branch recorder found {branch_recorder_edges} edges"
+    );
+
+    assert!(instruction_edges > 0, "Instruction tracing found no edges");
+    assert!(branch_recorder_edges > 0, "Branch recorder found no edges");
+
+    Ok(())
+}